@@ -34,6 +34,9 @@ def rm_logs():
     os.chdir("Logs")
     run_command("rm *.log")
     run_command("rm *.txt")
+    run_command("rm *.jsonl")
+    run_command("rm *_trace.json")
+    run_command("rm *_game.bin")
     os.chdir("..")
 
 if __name__=="__main__":
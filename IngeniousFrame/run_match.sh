@@ -30,4 +30,4 @@ java -jar ${IngeniousFrame} client -username foo -engine za.ac.sun.cs.ingenious.
 
 java -jar ${IngeniousFrame} client -username bar -engine za.ac.sun.cs.ingenious.games.othello.engines.OthelloMPIEngine -game OthelloReferee -hostname localhost -port 61235
 
-mv *.txt Logs/
+mv *.txt *.jsonl *_trace.json *_game.bin Logs/
@@ -52,27 +52,32 @@ def run_command(command, print_output=False):
     return output, error, exitCode
 
 
-def makePlayer():
+def makeFlags(size):
+    # players for another board size are built as my_player<size> and random<size>
+    return "" if size == 8 else f" BOARD_N={size}"
+
+
+def makePlayer(size=8):
     os.chdir("src_my_player")
-    run_command("make clean")
-    _, _, exitCode = run_command("make")
+    run_command("make clean" + makeFlags(size))
+    _, _, exitCode = run_command("make" + makeFlags(size))
     assert exitCode == 0, "make failed"
-    run_command("make clean")
+    run_command("make clean" + makeFlags(size))
     os.chdir("..")
 
 
-def makeRandomPlayer():
+def makeRandomPlayer(size=8):
     os.chdir("src_random_player")
-    run_command("make clean")
-    _, _, exitCode = run_command("make")
+    run_command("make clean" + makeFlags(size))
+    _, _, exitCode = run_command("make" + makeFlags(size))
     assert exitCode == 0, "make random failed"
-    run_command("make clean")
+    run_command("make clean" + makeFlags(size))
     os.chdir("..")
 
 
 def moveLogs():
     print("Moving log output to the Logs directory")
-    run_command("mv *.txt Logs/")
+    run_command("mv *.txt *.jsonl *_trace.json *_game.bin Logs/")
 
 
 def startServer():
@@ -115,11 +120,11 @@ def startPlayer(player, lid):
                     print("GAME WAS A DRAW!")
 
 
-def writeGameConf(p1, p2):
+def writeGameConf(p1, p2, size=8):
     game = {
         "numPlayers": 2,
         "threads": 4,
-        "boardSize": 8,
+        "boardSize": size,
         "time": 4,
         "turnLength": 4000,
         "path1": p1,
@@ -0,0 +1,139 @@
+import argparse
+import math
+import os
+import queue
+import sys
+from concurrent.futures import ThreadPoolExecutor, FIRST_COMPLETED, wait
+
+from run_rr import makePlayer, makeRandomPlayer
+from run_tournament import makeReferee, cpuGroups, playMatch
+
+
+def expectedScore(elo):
+    return 1 / (1 + 10 ** (-elo / 400))
+
+
+def elo(score):
+    score = min(max(score, 1e-6), 1 - 1e-6)
+    return -400 * math.log10(1 / score - 1)
+
+
+class Sprt:
+    """Sequential probability ratio test of H0: elo = elo0 against H1: elo = elo1,
+    with the normal approximation of the trinomial (win, draw, loss) score distribution"""
+
+    def __init__(self, elo0, elo1, alpha, beta):
+        self.s0 = expectedScore(elo0)
+        self.s1 = expectedScore(elo1)
+        self.lower = math.log(beta / (1 - alpha))
+        self.upper = math.log((1 - beta) / alpha)
+        self.wins = self.draws = self.losses = 0
+
+    def add(self, score):
+        if score == 1:
+            self.wins += 1
+        elif score == 0:
+            self.losses += 1
+        else:
+            self.draws += 1
+
+    def games(self):
+        return self.wins + self.draws + self.losses
+
+    def score(self):
+        return (self.wins + self.draws / 2) / self.games()
+
+    def variance(self):
+        # variance of the mean score per game
+        n = self.games()
+        s = self.score()
+        return (self.wins / n + self.draws / n / 4 - s * s) / n
+
+    def llr(self):
+        var = self.variance()
+        if self.games() == 0 or var <= 0:
+            return 0.0
+        return (self.s1 - self.s0) * (2 * self.score() - self.s0 - self.s1) / (2 * var)
+
+    def result(self):
+        llr = self.llr()
+        if llr >= self.upper:
+            return "H1 accepted"
+        if llr <= self.lower:
+            return "H0 accepted"
+        return None
+
+    def report(self):
+        s = self.score()
+        margin = 1.96 * math.sqrt(max(self.variance(), 0))
+        return (f"games {self.games()} (+{self.wins} ={self.draws} -{self.losses}) "
+                f"elo {elo(s):+.1f} [{elo(s - margin):+.1f}, {elo(s + margin):+.1f}] "
+                f"llr {self.llr():.2f} [{self.lower:.2f}, {self.upper:.2f}]")
+
+
+def gameScore(game, engine):
+    if game["winner"] == "draw":
+        return 0.5
+    return 1 if game[game["winner"]] == engine else 0
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Plays an engine against a baseline until a SPRT decides")
+    parser.add_argument("--engine", default="players/my_player", help="the engine under test")
+    parser.add_argument("--baseline", default="players/random", help="the engine it is compared to")
+    parser.add_argument("--elo0", type=float, default=0, help="elo difference of the null hypothesis")
+    parser.add_argument("--elo1", type=float, default=10, help="elo difference of the alternative hypothesis")
+    parser.add_argument("--alpha", type=float, default=0.05, help="probability of accepting H1 when H0 holds")
+    parser.add_argument("--beta", type=float, default=0.05, help="probability of accepting H0 when H1 holds")
+    parser.add_argument("--max-games", type=int, default=20000, help="stop without a decision after this many games")
+    parser.add_argument("--time", type=int, default=4, help="time limit per move in seconds")
+    parser.add_argument("--procs", type=int, default=4, help="MPI processes per player")
+    parser.add_argument("--jobs", type=int, default=0, help="concurrent game pairs, by default one per cpu group")
+    parser.add_argument("--mpirun", default="mpirun --bind-to none",
+                        help="MPI launcher, {cpus} is replaced by the cpus of the game pair")
+    parser.add_argument("--no-make", action="store_true", help="do not rebuild the players and the referee")
+    args = parser.parse_args()
+    # every job plays a pair of games with swapped colours
+    args.games = 2
+
+    if not args.no_make:
+        print("Making player...")
+        makePlayer()
+        print("Making Random Player...")
+        makeRandomPlayer()
+        print("Making Referee...")
+        makeReferee()
+    os.makedirs("Logs", exist_ok=True)
+
+    groups = queue.Queue()
+    cpuList = cpuGroups(args.procs)
+    for g in cpuList:
+        groups.put(g)
+    jobs = args.jobs if args.jobs > 0 else len(cpuList)
+
+    sprt = Sprt(args.elo0, args.elo1, args.alpha, args.beta)
+    decision = None
+    with ThreadPoolExecutor(max_workers=jobs) as pool:
+        running = set()
+        started = 0
+        while decision is None:
+            while len(running) < jobs and started + 2 * len(running) < args.max_games:
+                running.add(pool.submit(playMatch, args, groups, args.engine, args.baseline))
+            if not running:
+                break
+            done, running = wait(running, return_when=FIRST_COMPLETED)
+            for future in done:
+                for game in future.result():
+                    sprt.add(gameScore(game, args.engine))
+                started += 2
+            if sprt.games() > 0:
+                print(sprt.report())
+                decision = sprt.result()
+        # the pairs already running are finished, but not counted
+        for future in running:
+            future.cancel()
+
+    print(f"{decision or 'no decision'} after {sprt.games()} games")
+    if sprt.games() > 0:
+        print(sprt.report())
+    sys.exit(0 if decision == "H1 accepted" else 1)
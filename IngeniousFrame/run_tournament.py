@@ -0,0 +1,134 @@
+import argparse
+import itertools
+import json
+import os
+import queue
+import shlex
+import sys
+from concurrent.futures import ThreadPoolExecutor
+
+from run_rr import run_command, makePlayer, makeRandomPlayer
+
+REFEREE = "./referee"
+
+
+def makeReferee():
+    os.chdir("src_referee")
+    _, _, exitCode = run_command("make")
+    assert exitCode == 0, "make referee failed"
+    os.chdir("..")
+
+
+def cpuGroups(procs):
+    # one disjoint group of cores per concurrent match, each player rank gets
+    # a core of its own: a match needs 2 * procs cores
+    cpus = sorted(os.sched_getaffinity(0))
+    size = 2 * procs
+    groups = [cpus[i:i + size] for i in range(0, len(cpus) - size + 1, size)]
+    if not groups:
+        print(f"Only {len(cpus)} cpus, the matches share them", file=sys.stderr)
+        groups = [cpus]
+    return [",".join(str(c) for c in g) for g in groups]
+
+
+def boardSize(player):
+    # my_player6 and random10 play on the smaller and the larger board, see makeFlags
+    for size in (6, 10):
+        if os.path.basename(player).endswith(str(size)):
+            return size
+    return 8
+
+
+def pairings(players, engine, roundRobin):
+    if roundRobin:
+        return list(itertools.combinations(players, 2))
+    return [(engine, p) for p in players if p != engine]
+
+
+def playMatch(args, groups, p1, p2):
+    cpus = groups.get()
+    try:
+        mpirun = args.mpirun.format(cpus=cpus)
+        # players that stay up for all games of the match, see referee -d
+        daemons = "".join(str(i + 1) for i, p in enumerate((p1, p2))
+                          if os.path.basename(p) in getattr(args, "daemon", []))
+        command = (f"{REFEREE} -c {cpus} -g {args.games} -t {args.time} -n {args.procs} -s {getattr(args, 'size', 8)} "
+                   f"-m {shlex.quote(mpirun)} -l Logs {'-d ' + daemons if daemons else ''} {p1} {p2}")
+        print(f"Match of {p1} vs {p2} on cpus {cpus}")
+        output, error, exitCode = run_command(command)
+    finally:
+        groups.put(cpus)
+    if exitCode != 0:
+        print(f"Match of {p1} vs {p2} failed: {error.strip()}", file=sys.stderr)
+    return [json.loads(line) for line in output.splitlines() if line.startswith("{")]
+
+
+def standings(results):
+    table = {}
+    for game in results:
+        for player in (game["black"], game["white"]):
+            table.setdefault(player, [0, 0, 0])
+        if game["winner"] == "draw":
+            table[game["black"]][1] += 1
+            table[game["white"]][1] += 1
+        else:
+            loser = "white" if game["winner"] == "black" else "black"
+            table[game[game["winner"]]][0] += 1
+            table[game[loser]][2] += 1
+    print(f"{'player':30} {'won':>5} {'drawn':>5} {'lost':>5} {'score':>6}")
+    for player, (w, d, l) in sorted(table.items(), key=lambda e: -(e[1][0] + e[1][1] / 2)):
+        print(f"{player:30} {w:5} {d:5} {l:5} {w + d / 2:6.1f}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Plays the matches of a tournament concurrently, each on its own cpus")
+    parser.add_argument("--players", default="players", help="directory with the player executables")
+    parser.add_argument("--engine", default=None, help="player that meets every other player (my_player)")
+    parser.add_argument("--round-robin", action="store_true", help="every player meets every other player")
+    parser.add_argument("--games", type=int, default=2, help="games per match, colours alternate")
+    parser.add_argument("--time", type=int, default=4, help="time limit per move in seconds")
+    parser.add_argument("--procs", type=int, default=4, help="MPI processes per player")
+    parser.add_argument("--jobs", type=int, default=0, help="concurrent matches, by default one per cpu group")
+    parser.add_argument("--mpirun", default="mpirun --bind-to none",
+                        help="MPI launcher, {cpus} is replaced by the cpus of the match")
+    parser.add_argument("--daemon", nargs="*", default=[], metavar="PLAYER",
+                        help="players that support --daemon, started once per match")
+    parser.add_argument("--size", type=int, default=8, choices=(6, 8, 10),
+                        help="board size, only the players built for it take part (my_player6 for 6)")
+    parser.add_argument("--results", default="Logs/tournament.jsonl", help="file for the game results")
+    parser.add_argument("--no-make", action="store_true", help="do not rebuild the players and the referee")
+    args = parser.parse_args()
+    if args.engine is None:
+        args.engine = "my_player" + ("" if args.size == 8 else str(args.size))
+
+    if not args.no_make:
+        print("Making player...")
+        makePlayer(args.size)
+        print("Making Random Player...")
+        makeRandomPlayer(args.size)
+        print("Making Referee...")
+        makeReferee()
+    os.makedirs("Logs", exist_ok=True)
+
+    players = sorted(os.path.join(args.players, f) for f in os.listdir(args.players)
+                     if os.path.isfile(os.path.join(args.players, f)) and boardSize(f) == args.size)
+    engine = os.path.join(args.players, args.engine)
+    matches = pairings(players, engine, args.round_robin)
+
+    groups = queue.Queue()
+    cpuList = cpuGroups(args.procs)
+    for g in cpuList:
+        groups.put(g)
+    jobs = args.jobs if args.jobs > 0 else len(cpuList)
+
+    results = []
+    with ThreadPoolExecutor(max_workers=jobs) as pool:
+        futures = [pool.submit(playMatch, args, groups, p1, p2) for p1, p2 in matches]
+        for future in futures:
+            results.extend(future.result())
+
+    with open(args.results, "a") as outfile:
+        for game in results:
+            outfile.write(json.dumps(game) + "\n")
+    print(f"{len(matches)} matches, {len(results)} games, results in {args.results}")
+    standings(results)
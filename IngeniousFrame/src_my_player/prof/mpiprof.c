@@ -0,0 +1,327 @@
+/*H**********************************************************************
+ *
+ *    PMPI interposition layer, linked into the player with "make MPIPROF=1".
+ *
+ *    Every wrapped MPI call is timed and charged to its call site, i.e. the
+ *    function and offset that called it (resolved with backtrace_symbols, so
+ *    the player is linked with -rdynamic). At MPI_Finalize the summaries of
+ *    all ranks are gathered at rank 0 and written to a single file, named by
+ *    the MPIPROF_FILE environment variable or "mpiprof_<pid>.txt" by default.
+ *
+ *H***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <execinfo.h>
+#include <mpi.h>
+
+#define MAX_SITES 256
+#define SUMMARYBUFSIZE 65536
+
+struct call_site
+{
+	const char *function; // name of the wrapped MPI function
+	void *caller;		  // return address into the calling code
+	long long calls;
+	long long bytes;
+	double time;
+};
+
+static struct call_site sites[MAX_SITES];
+static int nr_sites;
+static double init_time;
+
+static void record(const char *function, void *caller, long long bytes, double time)
+{
+	int i;
+	for (i = 0; i < nr_sites; i++)
+	{
+		if (sites[i].caller == caller && sites[i].function == function)
+			break;
+	}
+	if (i == nr_sites)
+	{
+		if (nr_sites == MAX_SITES)
+			return;
+		sites[i].function = function;
+		sites[i].caller = caller;
+		nr_sites++;
+	}
+	sites[i].calls++;
+	sites[i].bytes += bytes;
+	sites[i].time += time;
+}
+
+static long long type_bytes(int count, MPI_Datatype datatype)
+{
+	int size = 0;
+	PMPI_Type_size(datatype, &size);
+	return (long long)count * size;
+}
+
+/* Times call and charges it to the code that called the wrapper */
+#define PROFILE(function, bytes, call)                                               \
+	do                                                                               \
+	{                                                                                \
+		double _t = PMPI_Wtime();                                                    \
+		int _result = call;                                                          \
+		record(function, __builtin_return_address(0), bytes, PMPI_Wtime() - _t);     \
+		return _result;                                                              \
+	} while (0)
+
+int MPI_Init(int *argc, char ***argv)
+{
+	int result = PMPI_Init(argc, argv);
+	init_time = PMPI_Wtime();
+	return result;
+}
+
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided)
+{
+	int result = PMPI_Init_thread(argc, argv, required, provided);
+	init_time = PMPI_Wtime();
+	return result;
+}
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm)
+{
+	PROFILE("MPI_Bcast", type_bytes(count, datatype),
+			PMPI_Bcast(buffer, count, datatype, root, comm));
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+			   void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+	PROFILE("MPI_Gather", type_bytes(sendcount, sendtype),
+			PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm));
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+				void *recvbuf, const int recvcounts[], const int displs[],
+				MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+	PROFILE("MPI_Gatherv", type_bytes(sendcount, sendtype),
+			PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm));
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count,
+			   MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm)
+{
+	PROFILE("MPI_Reduce", type_bytes(count, datatype),
+			PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm));
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count,
+				  MPI_Datatype datatype, MPI_Op op, MPI_Comm comm)
+{
+	PROFILE("MPI_Allreduce", type_bytes(count, datatype),
+			PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm));
+}
+
+int MPI_Barrier(MPI_Comm comm)
+{
+	PROFILE("MPI_Barrier", 0, PMPI_Barrier(comm));
+}
+
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm)
+{
+	PROFILE("MPI_Send", type_bytes(count, datatype),
+			PMPI_Send(buf, count, datatype, dest, tag, comm));
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag,
+			 MPI_Comm comm, MPI_Status *status)
+{
+	PROFILE("MPI_Recv", type_bytes(count, datatype),
+			PMPI_Recv(buf, count, datatype, source, tag, comm, status));
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag,
+			  MPI_Comm comm, MPI_Request *request)
+{
+	PROFILE("MPI_Isend", type_bytes(count, datatype),
+			PMPI_Isend(buf, count, datatype, dest, tag, comm, request));
+}
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source, int tag,
+			  MPI_Comm comm, MPI_Request *request)
+{
+	PROFILE("MPI_Irecv", type_bytes(count, datatype),
+			PMPI_Irecv(buf, count, datatype, source, tag, comm, request));
+}
+
+int MPI_Ibarrier(MPI_Comm comm, MPI_Request *request)
+{
+	PROFILE("MPI_Ibarrier", 0, PMPI_Ibarrier(comm, request));
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status)
+{
+	PROFILE("MPI_Wait", 0, PMPI_Wait(request, status));
+}
+
+int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status *array_of_statuses)
+{
+	PROFILE("MPI_Waitall", 0, PMPI_Waitall(count, array_of_requests, array_of_statuses));
+}
+
+int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status)
+{
+	PROFILE("MPI_Test", 0, PMPI_Test(request, flag, status));
+}
+
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status)
+{
+	PROFILE("MPI_Probe", 0, PMPI_Probe(source, tag, comm, status));
+}
+
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status)
+{
+	PROFILE("MPI_Iprobe", 0, PMPI_Iprobe(source, tag, comm, flag, status));
+}
+
+int MPI_Put(const void *origin_addr, int origin_count, MPI_Datatype origin_datatype,
+			int target_rank, MPI_Aint target_disp, int target_count,
+			MPI_Datatype target_datatype, MPI_Win win)
+{
+	PROFILE("MPI_Put", type_bytes(origin_count, origin_datatype),
+			PMPI_Put(origin_addr, origin_count, origin_datatype, target_rank, target_disp,
+					 target_count, target_datatype, win));
+}
+
+int MPI_Get(void *origin_addr, int origin_count, MPI_Datatype origin_datatype,
+			int target_rank, MPI_Aint target_disp, int target_count,
+			MPI_Datatype target_datatype, MPI_Win win)
+{
+	PROFILE("MPI_Get", type_bytes(origin_count, origin_datatype),
+			PMPI_Get(origin_addr, origin_count, origin_datatype, target_rank, target_disp,
+					 target_count, target_datatype, win));
+}
+
+int MPI_Accumulate(const void *origin_addr, int origin_count, MPI_Datatype origin_datatype,
+				   int target_rank, MPI_Aint target_disp, int target_count,
+				   MPI_Datatype target_datatype, MPI_Op op, MPI_Win win)
+{
+	PROFILE("MPI_Accumulate", type_bytes(origin_count, origin_datatype),
+			PMPI_Accumulate(origin_addr, origin_count, origin_datatype, target_rank, target_disp,
+							target_count, target_datatype, op, win));
+}
+
+int MPI_Win_fence(int assert, MPI_Win win)
+{
+	PROFILE("MPI_Win_fence", 0, PMPI_Win_fence(assert, win));
+}
+
+int MPI_Win_lock(int lock_type, int rank, int assert, MPI_Win win)
+{
+	PROFILE("MPI_Win_lock", 0, PMPI_Win_lock(lock_type, rank, assert, win));
+}
+
+int MPI_Win_unlock(int rank, MPI_Win win)
+{
+	PROFILE("MPI_Win_unlock", 0, PMPI_Win_unlock(rank, win));
+}
+
+static int by_time(const void *a, const void *b)
+{
+	const struct call_site *x = (const struct call_site *)a;
+	const struct call_site *y = (const struct call_site *)b;
+	if (x->time < y->time)
+		return 1;
+	if (x->time > y->time)
+		return -1;
+	return 0;
+}
+
+/**
+ * Writes the summary of this rank into buf, sorted by the time spent at each call site
+ */
+static int summarise(int rank, char *buf, int bufsize)
+{
+	int i, len;
+	double wall = PMPI_Wtime() - init_time;
+	double total = 0.0;
+	char **names;
+	void *callers[MAX_SITES];
+
+	qsort(sites, nr_sites, sizeof(struct call_site), by_time);
+	for (i = 0; i < nr_sites; i++)
+	{
+		callers[i] = sites[i].caller;
+		total += sites[i].time;
+	}
+	names = backtrace_symbols(callers, nr_sites);
+
+	len = snprintf(buf, bufsize, "rank %d: %.3f s in MPI of %.3f s wall (%.1f%%)\n",
+				   rank, total, wall, (wall > 0.0) ? 100.0 * total / wall : 0.0);
+	len += snprintf(buf + len, bufsize - len, "  %-14s %10s %12s %12s  %s\n",
+					"function", "calls", "bytes", "time [s]", "call site");
+	for (i = 0; i < nr_sites && len < bufsize; i++)
+	{
+		len += snprintf(buf + len, bufsize - len, "  %-14s %10lld %12lld %12.6f  %s\n",
+						sites[i].function, sites[i].calls, sites[i].bytes, sites[i].time,
+						(names != NULL) ? names[i] : "?");
+	}
+	free(names);
+	return (len < bufsize) ? len : bufsize - 1;
+}
+
+int MPI_Finalize(void)
+{
+	int rank, nr_of_procs, i, len;
+	int total = 0;
+	int pid = getpid();
+	int *lens = NULL;
+	int *displs = NULL;
+	char *all = NULL;
+	char *buf = (char *)malloc(SUMMARYBUFSIZE);
+	char filename[64];
+	const char *env_filename = getenv("MPIPROF_FILE");
+	FILE *fp;
+
+	PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	PMPI_Comm_size(MPI_COMM_WORLD, &nr_of_procs);
+
+	len = summarise(rank, buf, SUMMARYBUFSIZE);
+
+	if (rank == 0)
+	{
+		lens = (int *)malloc(nr_of_procs * sizeof(int));
+		displs = (int *)malloc(nr_of_procs * sizeof(int));
+	}
+	PMPI_Gather(&len, 1, MPI_INT, lens, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if (rank == 0)
+	{
+		for (i = 0; i < nr_of_procs; i++)
+		{
+			displs[i] = total;
+			total += lens[i];
+		}
+		all = (char *)malloc(total + 1);
+	}
+	PMPI_Gatherv(buf, len, MPI_CHAR, all, lens, displs, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+	if (rank == 0)
+	{
+		all[total] = '\0';
+		if (env_filename == NULL)
+		{
+			snprintf(filename, sizeof(filename), "mpiprof_%d.txt", pid);
+			env_filename = filename;
+		}
+		fp = fopen(env_filename, "w");
+		if (fp != NULL)
+		{
+			fputs(all, fp);
+			fclose(fp);
+		}
+	}
+
+	free(lens);
+	free(displs);
+	free(all);
+	free(buf);
+	return PMPI_Finalize();
+}
@@ -0,0 +1,334 @@
+#include "bitboard.h"
+
+#if BOARD_N <= 8 && defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#include <cpuid.h>
+#define BB_X86 // the AVX2 and BMI2 kernels
+#endif
+
+#define FILL_STEPS (BOARD_N - 3) // a run of discs to flip is at most BOARD_N - 2 long
+
+/*
+ * Scalar kernels. A direction is a shift by n, left (towards higher bits) or right,
+ * and the mask of the squares a shifted disc may land on without wrapping to the
+ * next row.
+ */
+
+static bitboard moves_left(bitboard own, bitboard opp, int n, bitboard mask)
+{
+	bitboard through = opp & mask;
+	bitboard run = (own << n) & through;
+	int i;
+
+	for (i = 0; i < FILL_STEPS; i++)
+		run |= (run << n) & through;
+	return (run << n) & mask;
+}
+
+static bitboard moves_right(bitboard own, bitboard opp, int n, bitboard mask)
+{
+	bitboard through = opp & mask;
+	bitboard run = (own >> n) & through;
+	int i;
+
+	for (i = 0; i < FILL_STEPS; i++)
+		run |= (run >> n) & through;
+	return (run >> n) & mask;
+}
+
+static bitboard moves_scalar(bitboard own, bitboard opp)
+{
+	bitboard moves;
+
+	moves = moves_left(own, opp, 1, BB_NOT_FIRST) | moves_right(own, opp, 1, BB_NOT_LAST);
+	moves |= moves_left(own, opp, BITBOARD_STRIDE, BB_REGION) | moves_right(own, opp, BITBOARD_STRIDE, BB_REGION);
+	moves |= moves_left(own, opp, BITBOARD_STRIDE + 1, BB_NOT_FIRST) | moves_right(own, opp, BITBOARD_STRIDE + 1, BB_NOT_LAST);
+	moves |= moves_left(own, opp, BITBOARD_STRIDE - 1, BB_NOT_LAST) | moves_right(own, opp, BITBOARD_STRIDE - 1, BB_NOT_FIRST);
+	return moves & ~(own | opp);
+}
+
+/* the run of opp from the move x, kept only if an own disc closes it */
+static bitboard flips_left(bitboard x, bitboard own, bitboard opp, int n, bitboard mask)
+{
+	bitboard through = opp & mask;
+	bitboard run = (x << n) & through;
+	int i;
+
+	for (i = 0; i < FILL_STEPS; i++)
+		run |= (run << n) & through;
+	return run & -(bitboard)(((run << n) & own & mask) != 0);
+}
+
+static bitboard flips_right(bitboard x, bitboard own, bitboard opp, int n, bitboard mask)
+{
+	bitboard through = opp & mask;
+	bitboard run = (x >> n) & through;
+	int i;
+
+	for (i = 0; i < FILL_STEPS; i++)
+		run |= (run >> n) & through;
+	return run & -(bitboard)(((run >> n) & own & mask) != 0);
+}
+
+static bitboard flips_scalar(int sq, bitboard own, bitboard opp)
+{
+	bitboard x = (bitboard)1 << sq;
+	bitboard flips;
+
+	flips = flips_left(x, own, opp, 1, BB_NOT_FIRST) | flips_right(x, own, opp, 1, BB_NOT_LAST);
+	flips |= flips_left(x, own, opp, BITBOARD_STRIDE, BB_REGION) | flips_right(x, own, opp, BITBOARD_STRIDE, BB_REGION);
+	flips |= flips_left(x, own, opp, BITBOARD_STRIDE + 1, BB_NOT_FIRST) | flips_right(x, own, opp, BITBOARD_STRIDE + 1, BB_NOT_LAST);
+	flips |= flips_left(x, own, opp, BITBOARD_STRIDE - 1, BB_NOT_LAST) | flips_right(x, own, opp, BITBOARD_STRIDE - 1, BB_NOT_FIRST);
+	return flips;
+}
+
+#ifdef BB_X86
+
+/*
+ * AVX2 kernels: the lanes are the shifts 1, 8, 9 and 7, once to the left and once to
+ * the right, so the eight directions take two registers and a fill step is two
+ * variable shifts. The lanes are ORed together at the end.
+ */
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i shifts(void)
+{
+	return _mm256_set_epi64x(7, 9, 8, 1);
+}
+
+AVX2 static inline __m256i masks_left(void)
+{
+	return _mm256_set_epi64x(BB_NOT_LAST, BB_NOT_FIRST, BB_REGION, BB_NOT_FIRST);
+}
+
+AVX2 static inline __m256i masks_right(void)
+{
+	return _mm256_set_epi64x(BB_NOT_FIRST, BB_NOT_LAST, BB_REGION, BB_NOT_LAST);
+}
+
+AVX2 static inline bitboard or_lanes(__m256i v)
+{
+	__m128i half = _mm_or_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+
+	return _mm_cvtsi128_si64(_mm_or_si128(half, _mm_unpackhi_epi64(half, half)));
+}
+
+AVX2 static bitboard moves_avx2(bitboard own, bitboard opp)
+{
+	__m256i n = shifts();
+	__m256i mask_l = masks_left(), mask_r = masks_right();
+	__m256i own4 = _mm256_set1_epi64x(own), opp4 = _mm256_set1_epi64x(opp);
+	__m256i through_l = _mm256_and_si256(opp4, mask_l), through_r = _mm256_and_si256(opp4, mask_r);
+	__m256i run_l = _mm256_and_si256(_mm256_sllv_epi64(own4, n), through_l);
+	__m256i run_r = _mm256_and_si256(_mm256_srlv_epi64(own4, n), through_r);
+	int i;
+
+	for (i = 0; i < FILL_STEPS; i++)
+	{
+		run_l = _mm256_or_si256(run_l, _mm256_and_si256(_mm256_sllv_epi64(run_l, n), through_l));
+		run_r = _mm256_or_si256(run_r, _mm256_and_si256(_mm256_srlv_epi64(run_r, n), through_r));
+	}
+	run_l = _mm256_and_si256(_mm256_sllv_epi64(run_l, n), mask_l);
+	run_r = _mm256_and_si256(_mm256_srlv_epi64(run_r, n), mask_r);
+	return or_lanes(_mm256_or_si256(run_l, run_r)) & ~(own | opp);
+}
+
+AVX2 static bitboard flips_avx2(int sq, bitboard own, bitboard opp)
+{
+	__m256i n = shifts();
+	__m256i mask_l = masks_left(), mask_r = masks_right();
+	__m256i x4 = _mm256_set1_epi64x((bitboard)1 << sq);
+	__m256i own4 = _mm256_set1_epi64x(own), opp4 = _mm256_set1_epi64x(opp);
+	__m256i through_l = _mm256_and_si256(opp4, mask_l), through_r = _mm256_and_si256(opp4, mask_r);
+	__m256i run_l = _mm256_and_si256(_mm256_sllv_epi64(x4, n), through_l);
+	__m256i run_r = _mm256_and_si256(_mm256_srlv_epi64(x4, n), through_r);
+	__m256i end_l, end_r;
+	int i;
+
+	for (i = 0; i < FILL_STEPS; i++)
+	{
+		run_l = _mm256_or_si256(run_l, _mm256_and_si256(_mm256_sllv_epi64(run_l, n), through_l));
+		run_r = _mm256_or_si256(run_r, _mm256_and_si256(_mm256_srlv_epi64(run_r, n), through_r));
+	}
+	/* a run without an own disc after it flips nothing */
+	end_l = _mm256_and_si256(_mm256_sllv_epi64(run_l, n), _mm256_and_si256(own4, mask_l));
+	end_r = _mm256_and_si256(_mm256_srlv_epi64(run_r, n), _mm256_and_si256(own4, mask_r));
+	run_l = _mm256_andnot_si256(_mm256_cmpeq_epi64(end_l, _mm256_setzero_si256()), run_l);
+	run_r = _mm256_andnot_si256(_mm256_cmpeq_epi64(end_r, _mm256_setzero_si256()), run_r);
+	return or_lanes(_mm256_or_si256(run_l, run_r));
+}
+
+/*
+ * BMI2 kernel: the four lines (row, column and both diagonals) through every square and
+ * the position of the square on each of them. A line has at most 8 squares, so its discs
+ * are gathered into a byte and looked up in
+ *   outflank[pos][opp]   the squares just after the runs of opp on both sides of pos
+ *   flipped[pos][ends]   the squares between pos and the outflanking own discs ends
+ */
+
+#define BMI2 __attribute__((target("bmi2")))
+
+struct line
+{
+	uint64_t mask;
+	int pos;
+};
+
+static struct line lines[64][4];
+static uint8_t outflank[8][256];
+static uint8_t flipped[8][256];
+static int lines_ready;
+
+static void init_lines(void)
+{
+	static const int dr[4] = {0, 1, 1, 1};
+	static const int dc[4] = {1, 0, 1, -1};
+	int r, c, d, i, k, pos, bits, out;
+
+	for (r = 0; r < BOARD_N; r++)
+	{
+		for (c = 0; c < BOARD_N; c++)
+		{
+			for (d = 0; d < 4; d++)
+			{
+				for (k = 0; r - (k + 1) * dr[d] >= 0 && c - (k + 1) * dc[d] >= 0 && c - (k + 1) * dc[d] < BOARD_N; k++)
+					;
+				lines[r * 8 + c][d].pos = k;
+				lines[r * 8 + c][d].mask = 0;
+				for (i = -k; r + i * dr[d] < BOARD_N && c + i * dc[d] >= 0 && c + i * dc[d] < BOARD_N; i++)
+					lines[r * 8 + c][d].mask |= 1ULL << ((r + i * dr[d]) * 8 + c + i * dc[d]);
+			}
+		}
+	}
+	for (pos = 0; pos < 8; pos++)
+	{
+		for (bits = 0; bits < 256; bits++)
+		{
+			out = 0;
+			for (i = pos + 1; i < 8 && (bits >> i & 1); i++)
+				;
+			if (i > pos + 1 && i < 8)
+				out |= 1 << i;
+			for (i = pos - 1; i >= 0 && (bits >> i & 1); i--)
+				;
+			if (i < pos - 1 && i >= 0)
+				out |= 1 << i;
+			outflank[pos][bits] = out;
+
+			out = 0;
+			for (i = 0; i < 8; i++)
+			{
+				if (bits >> i & 1)
+					out |= (i > pos) ? ((1 << i) - (2 << pos)) : ((1 << pos) - (2 << i));
+			}
+			flipped[pos][bits] = out;
+		}
+	}
+	lines_ready = 1;
+}
+
+BMI2 static bitboard flips_bmi2(int sq, bitboard own, bitboard opp)
+{
+	const struct line *line = lines[sq];
+	bitboard flips = 0;
+	int d, ends;
+
+	for (d = 0; d < 4; d++)
+	{
+		ends = outflank[line[d].pos][_pext_u64(opp, line[d].mask)] & _pext_u64(own, line[d].mask);
+		flips |= _pdep_u64(flipped[line[d].pos][ends], line[d].mask);
+	}
+	return flips;
+}
+
+/* PEXT and PDEP are microcoded, and slow, on AMD cpus before Zen 3 (family 0x19) */
+static int fast_bmi2(void)
+{
+	unsigned eax, ebx, ecx, edx;
+
+	if (!__builtin_cpu_supports("bmi2"))
+		return 0;
+	if (!__builtin_cpu_is("amd"))
+		return 1;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return ((eax >> 8) & 0xf) + ((eax >> 20) & 0xff) >= 0x19;
+}
+
+#endif
+
+const char *bb_kernel_names[BB_NR_KERNELS] = {"scalar", "avx2", "bmi2"};
+
+bitboard (*bb_moves)(bitboard own, bitboard opp) = moves_scalar;
+bitboard (*bb_flips)(int sq, bitboard own, bitboard opp) = flips_scalar;
+static int kernel = BB_SCALAR;
+
+/* the fastest kernel of the cpu: BMI2 flips where PEXT is fast, else AVX2, else scalar */
+void bb_init(void)
+{
+#ifdef BB_X86
+	__builtin_cpu_init();
+	if (fast_bmi2() && bb_use(BB_BMI2))
+		return;
+#endif
+	if (!bb_use(BB_AVX2))
+		bb_use(BB_SCALAR);
+}
+
+/* selects a kernel, 0 if the cpu (or the board size) does not have it */
+int bb_use(int k)
+{
+	if (k == BB_SCALAR)
+	{
+		bb_moves = moves_scalar;
+		bb_flips = flips_scalar;
+		kernel = k;
+		return 1;
+	}
+#ifdef BB_X86
+	if (k == BB_AVX2 && __builtin_cpu_supports("avx2"))
+	{
+		bb_moves = moves_avx2;
+		bb_flips = flips_avx2;
+		kernel = k;
+		return 1;
+	}
+	if (k == BB_BMI2 && __builtin_cpu_supports("bmi2"))
+	{
+		if (!lines_ready)
+			init_lines();
+		bb_moves = __builtin_cpu_supports("avx2") ? moves_avx2 : moves_scalar;
+		bb_flips = flips_bmi2;
+		kernel = k;
+		return 1;
+	}
+#endif
+	return 0;
+}
+
+int bb_kernel(void)
+{
+	return kernel;
+}
+
+/* recomputes the bitboards of a board after its squares were written directly */
+void bb_sync(int *board)
+{
+	bitboard black = 0, white = 0;
+	int r, c, piece;
+
+	for (r = 0; r < BOARD_N; r++)
+	{
+		for (c = 0; c < BOARD_N; c++)
+		{
+			piece = board[BOARD_LOC(r, c)];
+			if (piece == 1)
+				black |= (bitboard)1 << (r * BITBOARD_STRIDE + c);
+			else if (piece == 2)
+				white |= (bitboard)1 << (r * BITBOARD_STRIDE + c);
+		}
+	}
+	bb_set(board, 1, black);
+	bb_set(board, 2, white);
+}
@@ -0,0 +1,94 @@
+#ifndef _BITBOARD_H
+#define _BITBOARD_H
+
+#include <string.h>
+#include "board.h"
+
+/**
+ * Move generation and flips on the bitboards kept after the mailbox (board.h).
+ *
+ * Both are Kogge-Stone style fills: the discs of one side are shifted one square at a
+ * time in every direction through the discs of the other side, BOARD_N - 3 times, so
+ * the work is the same for every position and has no data dependent branches. With
+ * AVX2 four directions share a register, otherwise (and for the 128 bit 10x10 board)
+ * the directions are done one after the other. On cpus with fast BMI2 the flips are
+ * instead looked up per line through the move: PEXT gathers the line's discs into a
+ * byte, two small tables give the flipped ones and PDEP puts them back. bb_init picks
+ * the fastest kernel at run time, bb_use selects one, e.g. to compare them (--perft).
+ */
+
+/* the squares of a board of BOARD_N columns */
+#if BOARD_N <= 8
+#define BB_COL0 (0x0101010101010101ULL >> (8 * (8 - BOARD_N)))
+#else
+#define BB_COL0 ((((bitboard)1 << (BITBOARD_STRIDE * BOARD_N)) - 1) / (((bitboard)1 << BITBOARD_STRIDE) - 1))
+#endif
+#define BB_REGION ((((bitboard)1 << BOARD_N) - 1) * BB_COL0)
+#define BB_NOT_FIRST (BB_REGION & ~BB_COL0)						  // all but the first column
+#define BB_NOT_LAST (BB_REGION & ~(BB_COL0 << (BOARD_N - 1))) // all but the last column
+
+/* the moves of own against opp, and the discs of opp that a move on bit sq flips */
+extern bitboard (*bb_moves)(bitboard own, bitboard opp);
+extern bitboard (*bb_flips)(int sq, bitboard own, bitboard opp);
+
+enum bb_kernel
+{
+	BB_SCALAR, // fills one direction at a time
+	BB_AVX2,   // fills four directions per register
+	BB_BMI2,   // AVX2 (or scalar) moves, flips by PEXT/PDEP line lookups
+	BB_NR_KERNELS
+};
+
+extern const char *bb_kernel_names[BB_NR_KERNELS];
+
+void bb_init(void);
+int bb_use(int kernel);
+int bb_kernel(void);
+void bb_sync(int *board);
+
+/* the bitboard of colour (1 black, 2 white) in board */
+static inline bitboard bb_get(const int *board, int colour)
+{
+	bitboard b;
+
+	memcpy(&b, board + BOARD_BITS + (colour - 1) * (int)(sizeof(b) / sizeof(int)), sizeof(b));
+	return b;
+}
+
+static inline void bb_set(int *board, int colour, bitboard b)
+{
+	memcpy(board + BOARD_BITS + (colour - 1) * (int)(sizeof(b) / sizeof(int)), &b, sizeof(b));
+}
+
+static inline int bb_square(int loc)
+{
+	return BOARD_ROW(loc) * BITBOARD_STRIDE + BOARD_COL(loc);
+}
+
+static inline int bb_loc(int sq)
+{
+	return BOARD_LOC(sq / BITBOARD_STRIDE, sq % BITBOARD_STRIDE);
+}
+
+/* lowest set bit of b, b != 0 */
+static inline int bb_first(bitboard b)
+{
+#if BOARD_N <= 8
+	return __builtin_ctzll(b);
+#else
+	uint64_t low = (uint64_t)b;
+
+	return low ? __builtin_ctzll(low) : 64 + __builtin_ctzll((uint64_t)(b >> 64));
+#endif
+}
+
+static inline int bb_count(bitboard b)
+{
+#if BOARD_N <= 8
+	return __builtin_popcountll(b);
+#else
+	return __builtin_popcountll((uint64_t)b) + __builtin_popcountll((uint64_t)(b >> 64));
+#endif
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef _BOARD_H
+#define _BOARD_H
+
+#include <stdint.h>
+
+/**
+ * Dimensions of the board, fixed at compile time: make BOARD_N=6 (or 10) builds an
+ * engine for that board, the default is the standard 8x8 game.
+ *
+ * The board is a mailbox of BOARD_WIDTH * BOARD_WIDTH squares, the BOARD_N * BOARD_N
+ * squares of the game surrounded by a border of OUTER squares. Row r, column c
+ * (0 based) is square BOARD_LOC(r, c), the referee's move "rc" is the same square.
+ * The mailbox is followed by the discs of black and of white as bitboards (bitboard.h),
+ * so copying BOARD_INTS ints copies both.
+ *
+ * Up to 8x8 a bitboard is a 64 bit word, bit r * 8 + c is row r, column c, and a smaller
+ * board lies in its top left corner. The 10x10 board needs 100 bits, bit r * 10 + c of a
+ * 128 bit word.
+ */
+
+#ifndef BOARD_N
+#define BOARD_N 8
+#endif
+
+#if BOARD_N != 6 && BOARD_N != 8 && BOARD_N != 10
+#error "BOARD_N must be 6, 8 or 10"
+#endif
+
+#define BOARD_WIDTH (BOARD_N + 2)
+#define BOARD_SQUARES (BOARD_WIDTH * BOARD_WIDTH)
+#define BOARD_CELLS (BOARD_N * BOARD_N) // squares of the game
+
+#if BOARD_N <= 8
+typedef uint64_t bitboard;
+#define BITBOARD_STRIDE 8
+#else
+__extension__ typedef unsigned __int128 bitboard;
+#define BITBOARD_STRIDE BOARD_N
+#endif
+
+#define BOARD_BITS BOARD_SQUARES // index of the bitboards in the board
+#define BOARD_INTS (BOARD_SQUARES + 2 * (int)(sizeof(bitboard) / sizeof(int)))
+
+#define BOARD_LOC(row, col) (BOARD_WIDTH * ((row) + 1) + (col) + 1)
+#define BOARD_ROW(loc) ((loc) / BOARD_WIDTH - 1)
+#define BOARD_COL(loc) ((loc) % BOARD_WIDTH - 1)
+#define BOARD_FIRST BOARD_LOC(0, 0)
+#define BOARD_LAST BOARD_LOC(BOARD_N - 1, BOARD_N - 1)
+
+/* suffix of the files that only hold positions of this board size, "" for 8x8 */
+#if BOARD_N == 8
+#define BOARD_SUFFIX ""
+#elif BOARD_N == 6
+#define BOARD_SUFFIX "6"
+#else
+#define BOARD_SUFFIX "10"
+#endif
+
+#endif
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "comms.h"
+#include "book.h"
+
+struct book_header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t entry_size;
+	uint32_t nr_entries;
+};
+
+static const char magic[4] = {'O', 'T', 'H', 'B'};
+
+static const struct book_header *header;
+static const struct book_entry *entries;
+static size_t mapped_size;
+
+/**
+ * Maps the book, FAILURE if there is none or it was written in another format
+ */
+int book_open(const char *filename)
+{
+	struct stat st;
+	void *map;
+	int fd = open(filename, O_RDONLY);
+
+	if (fd == -1)
+		return FAILURE;
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct book_header))
+	{
+		close(fd);
+		return FAILURE;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); // the mapping stays
+	if (map == MAP_FAILED)
+		return FAILURE;
+
+	header = (const struct book_header *)map;
+	mapped_size = st.st_size;
+	if (memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != BOOK_VERSION ||
+		header->entry_size != sizeof(struct book_entry) ||
+		mapped_size != sizeof(struct book_header) + (size_t)header->nr_entries * sizeof(struct book_entry))
+	{
+		book_close();
+		return FAILURE;
+	}
+	entries = (const struct book_entry *)(header + 1);
+	return SUCCESS;
+}
+
+void book_close(void)
+{
+	if (header != NULL)
+		munmap((void *)header, mapped_size);
+	header = NULL;
+	entries = NULL;
+}
+
+/**
+ * Finds the moves of the position by binary search and copies the one with the
+ * best score, of the equal ones the most played, to best. FAILURE if the
+ * position is not in the book.
+ */
+int book_probe(uint64_t key, struct book_entry *best)
+{
+	uint32_t lo = 0, hi, mid;
+	const struct book_entry *e;
+
+	if (entries == NULL)
+		return FAILURE;
+
+	/* first entry with a key >= key */
+	hi = header->nr_entries;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (entries[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == header->nr_entries || entries[lo].key != key)
+		return FAILURE;
+
+	*best = entries[lo];
+	for (e = &entries[lo + 1]; e < entries + header->nr_entries && e->key == key; e++)
+	{
+		if (e->score > best->score || (e->score == best->score && e->count > best->count))
+			*best = *e;
+	}
+	return SUCCESS;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	const struct book_entry *x = (const struct book_entry *)a;
+	const struct book_entry *y = (const struct book_entry *)b;
+
+	if (x->key != y->key)
+		return (x->key < y->key) ? -1 : 1;
+	return x->move - y->move;
+}
+
+/**
+ * Sorts the entries and writes them as a book. The file is written under a
+ * temporary name first, so a player never maps a half written book.
+ */
+int book_write(const char *filename, struct book_entry *entries, int n)
+{
+	struct book_header h;
+	char *tmp = (char *)malloc(strlen(filename) + 5);
+	int result = SUCCESS;
+	FILE *fp;
+
+	qsort(entries, n, sizeof(struct book_entry), compare_entries);
+	memcpy(h.magic, magic, sizeof(magic));
+	h.version = BOOK_VERSION;
+	h.entry_size = sizeof(struct book_entry);
+	h.nr_entries = n;
+
+	sprintf(tmp, "%s.tmp", filename);
+	fp = fopen(tmp, "wb");
+	if (fp == NULL)
+		result = FAILURE;
+	else if (fwrite(&h, sizeof(h), 1, fp) != 1 || (int)fwrite(entries, sizeof(struct book_entry), n, fp) != n)
+		result = FAILURE;
+	if (fp != NULL && fclose(fp) != 0)
+		result = FAILURE;
+	if (result == SUCCESS && rename(tmp, filename) != 0)
+		result = FAILURE;
+	free(tmp);
+	return result;
+}
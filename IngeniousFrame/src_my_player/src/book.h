@@ -0,0 +1,31 @@
+#ifndef _BOOK_H
+#define _BOOK_H
+
+#include <stdint.h>
+
+/**
+ * Opening book, memory mapped read-only by rank 0 (my_player.c).
+ *
+ * Layout, in the byte order of the machine that wrote it:
+ *   "OTHB", version, size of an entry, number of entries (uint32 each),
+ *   then the entries sorted by key, the moves of a position next to each other.
+ * The key of a position is tt_hash (tt.h) of the board and the side to move, which is
+ * the same for the 8 symmetric boards; the moves are those of the turned board.
+ */
+
+#define BOOK_VERSION 2
+
+struct book_entry
+{
+	uint64_t key;
+	int16_t move;	// mailbox square of the turned board, see tt_hash
+	int16_t score;	// from the side to move
+	uint32_t count; // games, or searches, that led to the score
+};
+
+int book_open(const char *filename);
+void book_close(void);
+int book_probe(uint64_t key, struct book_entry *best);
+int book_write(const char *filename, struct book_entry *entries, int n);
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include "comms.h" 
@@ -47,7 +48,7 @@ int comms_init_network(int* my_colour, unsigned long ip, int port) {
  */
 int comms_get_colour(int* my_colour) {
 	char tempColour[2]; tempColour[1] = 0;
-	if(recv(socket_desc, tempColour , 1, 0) < 0){
+	if(recv(socket_desc, tempColour , 1, 0) <= 0){
 		#ifdef DEBUG
 		printf("Comms error: Could not receive colour\n");
 		#endif
@@ -74,13 +75,14 @@ int comms_get_cmd(char cmd[], char move[]) {
 	memset(len_buf, 0, LENBUFSIZE);
 	memset(msg_buf, 0, MSGBUFSIZE);
 
-	if (recv(socket_desc, len_buf , 2, 0) < 0){
+	if (recv(socket_desc, len_buf , 2, 0) <= 0){
+		/* 0: the referee closed the connection */
 		result = FAILURE;
 	} else {
 
 		msg_len = atoi(len_buf);
 	
-		if (recv(socket_desc, msg_buf, msg_len, 0) < 0){
+		if (msg_len <= 0 || msg_len >= MSGBUFSIZE || recv(socket_desc, msg_buf, msg_len, 0) <= 0){
 			result = FAILURE; 
 		} else {
 
@@ -118,3 +120,10 @@ int comms_send_move(char my_move[]) {
 
 	return SUCCESS;
 }
+
+/**
+ * Closes the connection to the server, comms_init_network opens the next one
+ */
+void comms_close(void) {
+	close(socket_desc);
+}
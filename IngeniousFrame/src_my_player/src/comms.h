@@ -11,5 +11,6 @@ int comms_init(int* my_colour);
 int comms_init_network(int* my_colour, unsigned long ip, int port);
 int comms_get_cmd(char cmd[], char move[]);
 int comms_send_move(char move[]);
+void comms_close(void);
 
 #endif
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "comms.h"
+#include "experience.h"
+
+struct experience_header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t entry_size;
+	uint32_t nr_slots;
+};
+
+static const char magic[4] = {'O', 'T', 'H', 'X'};
+
+static int fd = -1;
+static struct experience_header *header;
+static struct tt_entry *slots;
+static size_t mapped_size;
+
+/**
+ * Maps the experience file, which is created empty if it does not exist.
+ * FAILURE if it cannot be opened or was written in another format.
+ */
+int experience_open(const char *filename)
+{
+	struct stat st;
+	size_t size = sizeof(struct experience_header) + (size_t)EXPERIENCE_SLOTS * sizeof(struct tt_entry);
+	void *map;
+
+	fd = open(filename, O_RDWR | O_CREAT, 0644);
+	if (fd == -1)
+		return FAILURE;
+	flock(fd, LOCK_EX);
+	if (fstat(fd, &st) == -1 || (st.st_size == 0 && ftruncate(fd, size) == -1))
+	{
+		flock(fd, LOCK_UN);
+		experience_close();
+		return FAILURE;
+	}
+	if (st.st_size != 0)
+		size = st.st_size;
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+	{
+		flock(fd, LOCK_UN);
+		experience_close();
+		return FAILURE;
+	}
+	header = (struct experience_header *)map;
+	mapped_size = size;
+	if (st.st_size == 0)
+	{
+		memcpy(header->magic, magic, sizeof(magic));
+		header->version = EXPERIENCE_VERSION;
+		header->entry_size = sizeof(struct tt_entry);
+		header->nr_slots = EXPERIENCE_SLOTS;
+	}
+	flock(fd, LOCK_UN);
+
+	if (memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != EXPERIENCE_VERSION ||
+		header->entry_size != sizeof(struct tt_entry) || header->nr_slots == 0 ||
+		(header->nr_slots & (header->nr_slots - 1)) != 0 ||
+		size != sizeof(struct experience_header) + (size_t)header->nr_slots * sizeof(struct tt_entry))
+	{
+		experience_close();
+		return FAILURE;
+	}
+	slots = (struct tt_entry *)(header + 1);
+	return SUCCESS;
+}
+
+void experience_close(void)
+{
+	if (header != NULL)
+		munmap(header, mapped_size);
+	if (fd != -1)
+		close(fd);
+	header = NULL;
+	slots = NULL;
+	fd = -1;
+}
+
+/**
+ * The saved entry of the position with this key, NULL if there is none.
+ * Other players may write the file meanwhile, so the caller checks the move.
+ */
+const struct tt_entry *experience_probe(uint64_t key)
+{
+	uint32_t i, slot;
+
+	if (slots == NULL)
+		return NULL;
+	for (i = 0; i < EXPERIENCE_PROBES; i++)
+	{
+		slot = (key + i) & (header->nr_slots - 1);
+		if (slots[slot].flag == TT_EMPTY)
+			return NULL;
+		if (slots[slot].key == key)
+			return &slots[slot];
+	}
+	return NULL;
+}
+
+/**
+ * Copies every saved entry to a new array in *entries, which the caller frees.
+ * Returns their number, 0 without a file.
+ */
+int experience_entries(struct tt_entry **entries)
+{
+	uint32_t i;
+	int n = 0;
+
+	*entries = NULL;
+	if (slots == NULL)
+		return 0;
+	*entries = (struct tt_entry *)malloc((size_t)header->nr_slots * sizeof(struct tt_entry));
+	flock(fd, LOCK_SH);
+	for (i = 0; i < header->nr_slots; i++)
+	{
+		if (slots[i].flag != TT_EMPTY)
+			(*entries)[n++] = slots[i];
+	}
+	flock(fd, LOCK_UN);
+	return n;
+}
+
+/* keeps the deeper entry of a position, and evicts the shallowest one when all slots are taken */
+static void store(const struct tt_entry *e)
+{
+	struct tt_entry *victim = NULL;
+	uint32_t i;
+	struct tt_entry *s;
+
+	for (i = 0; i < EXPERIENCE_PROBES; i++)
+	{
+		s = &slots[(e->key + i) & (header->nr_slots - 1)];
+		if (s->flag == TT_EMPTY || s->key == e->key)
+		{
+			if (s->flag == TT_EMPTY || e->depth > s->depth || (e->depth == s->depth && e->flag == TT_EXACT))
+				*s = *e;
+			return;
+		}
+		if (victim == NULL || s->depth < victim->depth)
+			victim = s;
+	}
+	if (e->depth > victim->depth)
+		*victim = *e;
+}
+
+/**
+ * Adds entries to the file and writes it back to disk
+ */
+int experience_merge(const struct tt_entry *entries, int n)
+{
+	int i, result;
+
+	if (slots == NULL)
+		return FAILURE;
+	flock(fd, LOCK_EX);
+	for (i = 0; i < n; i++)
+	{
+		if (entries[i].flag != TT_EMPTY)
+			store(&entries[i]);
+	}
+	result = (msync(header, mapped_size, MS_SYNC) == 0) ? SUCCESS : FAILURE;
+	flock(fd, LOCK_UN);
+	return result;
+}
@@ -0,0 +1,28 @@
+#ifndef _EXPERIENCE_H
+#define _EXPERIENCE_H
+
+#include "tt.h"
+
+/**
+ * Experience file: the deep transposition table entries and the root results of
+ * earlier games, kept on disk and memory mapped by rank 0 (my_player.c).
+ *
+ * Layout, in the byte order of the machine that created it:
+ *   "OTHX", version, size of an entry, number of slots (uint32 each),
+ *   then the slots, struct tt_entry each. A position lives in one of
+ *   EXPERIENCE_PROBES slots from key % slots on; flag TT_EMPTY marks a free slot.
+ * Several players may share the file, changes are made under an exclusive flock.
+ */
+
+#define EXPERIENCE_VERSION 2
+#define EXPERIENCE_SLOTS (1 << 18) // 4 MiB
+#define EXPERIENCE_PROBES 4
+#define EXPERIENCE_MIN_DEPTH 3 // shallower entries are not worth saving
+
+int experience_open(const char *filename);
+void experience_close(void);
+const struct tt_entry *experience_probe(uint64_t key);
+int experience_entries(struct tt_entry **entries);
+int experience_merge(const struct tt_entry *entries, int n);
+
+#endif
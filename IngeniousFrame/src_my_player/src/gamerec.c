@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <string.h>
+#include "comms.h"
+#include "gamerec.h"
+
+static const char magic[4] = {'O', 'T', 'H', 'G'};
+
+void gamerec_init(struct game_record *rec, int my_colour, int size)
+{
+	memset(rec, 0, sizeof(*rec));
+	rec->my_colour = my_colour;
+	rec->size = size;
+}
+
+/**
+ * Appends a move, square -1 for a pass; moves beyond GAMEREC_MAX_MOVES are dropped
+ */
+void gamerec_add(struct game_record *rec, int colour, int square)
+{
+	if (rec->nr_moves == GAMEREC_MAX_MOVES)
+		return;
+	rec->colours[rec->nr_moves] = colour;
+	rec->squares[rec->nr_moves] = (square < 0) ? GAMEREC_PASS : square;
+	rec->nr_moves++;
+}
+
+int gamerec_write(const struct game_record *rec, const char *filename)
+{
+	unsigned char header[9];
+	int i, result = SUCCESS;
+	FILE *fp = fopen(filename, "wb");
+
+	if (fp == NULL)
+		return FAILURE;
+	memcpy(header, magic, sizeof(magic));
+	header[4] = GAMEREC_VERSION;
+	header[5] = rec->my_colour;
+	header[6] = rec->size;
+	header[7] = rec->nr_moves >> 8;
+	header[8] = rec->nr_moves & 0xff;
+	if (fwrite(header, 1, sizeof(header), fp) != sizeof(header))
+		result = FAILURE;
+	for (i = 0; i < rec->nr_moves && result == SUCCESS; i++)
+	{
+		if (fputc(rec->colours[i], fp) == EOF || fputc(rec->squares[i], fp) == EOF)
+			result = FAILURE;
+	}
+	if (fclose(fp) != 0)
+		result = FAILURE;
+	return result;
+}
+
+/**
+ * Reads a record written by gamerec_write, FAILURE if the file is not one or is cut short
+ */
+int gamerec_read(struct game_record *rec, const char *filename)
+{
+	unsigned char header[9];
+	int i, c, s, result = SUCCESS;
+	FILE *fp = fopen(filename, "rb");
+
+	if (fp == NULL)
+		return FAILURE;
+	if (fread(header, 1, sizeof(header), fp) != sizeof(header) || memcmp(header, magic, sizeof(magic)) != 0 ||
+		header[4] != GAMEREC_VERSION)
+	{
+		fclose(fp);
+		return FAILURE;
+	}
+	gamerec_init(rec, header[5], header[6]);
+	rec->nr_moves = (header[7] << 8) | header[8];
+	if (rec->nr_moves > GAMEREC_MAX_MOVES)
+		result = FAILURE;
+	for (i = 0; i < rec->nr_moves && result == SUCCESS; i++)
+	{
+		c = fgetc(fp);
+		s = fgetc(fp);
+		if (c == EOF || s == EOF)
+			result = FAILURE;
+		rec->colours[i] = c;
+		rec->squares[i] = s;
+	}
+	fclose(fp);
+	return result;
+}
@@ -0,0 +1,32 @@
+#ifndef _GAMEREC_H
+#define _GAMEREC_H
+
+/**
+ * Binary record of a finished game, written by rank 0 next to the log file
+ * (<log>_game.bin) and read back by the blunder analysis (my_player --blunders).
+ *
+ * Layout, all fields single bytes so the file does not depend on the machine:
+ *   "OTHG", version, colour of the player that wrote it, board size,
+ *   number of moves (two bytes, big endian), then per move its colour and
+ *   its square (row * size + column, GAMEREC_PASS for a pass).
+ */
+
+#define GAMEREC_VERSION 1
+#define GAMEREC_MAX_MOVES 256
+#define GAMEREC_PASS 255
+
+struct game_record
+{
+	int my_colour;
+	int size; // squares per side of the board
+	int nr_moves;
+	unsigned char colours[GAMEREC_MAX_MOVES];
+	unsigned char squares[GAMEREC_MAX_MOVES];
+};
+
+void gamerec_init(struct game_record *rec, int my_colour, int size);
+void gamerec_add(struct game_record *rec, int colour, int square);
+int gamerec_write(const struct game_record *rec, const char *filename);
+int gamerec_read(struct game_record *rec, const char *filename);
+
+#endif
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "log.h"
+
+#define LOG_SLOTS 256	  // records in the ring, a power of two
+#define LOG_SLOTSIZE 1024 // bytes of text or board per record, the 10x10 board has 144 squares
+#define LOG_IDLE_NSEC 1000000 // the writer sleeps 1ms when the ring is empty
+
+enum record_kind
+{
+	RECORD_TEXT,
+	RECORD_BOARD
+};
+
+struct log_record
+{
+	int kind;
+	int len; // bytes of text, or number of squares of the board
+	union
+	{
+		char text[LOG_SLOTSIZE];
+		int board[LOG_SLOTSIZE / sizeof(int)];
+	} data;
+};
+
+static struct log_record ring[LOG_SLOTS];
+static atomic_uint head; // next slot to write, only advanced by the logging thread
+static atomic_uint tail; // next slot to read, only advanced by the writer thread
+static atomic_int stop;
+static unsigned dropped;
+
+static FILE *log_fp;
+static const char *log_filename;
+static int own_file; // the logger opened log_fp and closes it
+static void (*board_printer)(FILE *fp, int *board);
+static pthread_t writer;
+static int started;
+
+/* Opens the log file on the first record, so ranks that never log create no file */
+static FILE *log_file(void)
+{
+	if (log_fp == NULL && log_filename != NULL)
+	{
+		log_fp = fopen(log_filename, "w");
+		own_file = (log_fp != NULL);
+		log_filename = NULL;
+	}
+	return (log_fp != NULL) ? log_fp : stderr;
+}
+
+/* Formats and writes all records in the ring, returns the number written */
+static int drain(void)
+{
+	unsigned t = atomic_load_explicit(&tail, memory_order_relaxed);
+	unsigned h = atomic_load_explicit(&head, memory_order_acquire);
+	struct log_record *r;
+	FILE *fp;
+
+	if (t == h)
+		return 0;
+
+	fp = log_file();
+	for (; t != h; t++)
+	{
+		r = &ring[t % LOG_SLOTS];
+		if (r->kind == RECORD_BOARD && board_printer != NULL)
+			board_printer(fp, r->data.board);
+		else if (r->kind == RECORD_TEXT)
+			fwrite(r->data.text, 1, r->len, fp);
+		atomic_store_explicit(&tail, t + 1, memory_order_release);
+	}
+	fflush(fp);
+	return 1;
+}
+
+static void *writer_main(void *arg)
+{
+	struct timespec idle = {0, LOG_IDLE_NSEC};
+
+	(void)arg;
+	while (!atomic_load_explicit(&stop, memory_order_acquire))
+	{
+		if (!drain())
+			nanosleep(&idle, NULL);
+	}
+	drain();
+	return NULL;
+}
+
+/**
+ * Starts the writer thread of this rank. Records go to fp if it is not NULL,
+ * otherwise to filename, which is only created once something is logged.
+ * printer formats the boards passed to log_board.
+ */
+void log_init(FILE *fp, const char *filename, void (*printer)(FILE *fp, int *board))
+{
+	log_fp = fp;
+	log_filename = filename;
+	own_file = 0;
+	board_printer = printer;
+	dropped = 0;
+	atomic_store(&head, 0);
+	atomic_store(&tail, 0);
+	atomic_store(&stop, 0);
+	started = (pthread_create(&writer, NULL, writer_main, NULL) == 0);
+}
+
+/**
+ * Writes the remaining records and stops the writer thread
+ */
+void log_finalize(void)
+{
+	FILE *fp;
+
+	if (started)
+	{
+		atomic_store_explicit(&stop, 1, memory_order_release);
+		pthread_join(writer, NULL);
+		started = 0;
+	}
+	else
+	{
+		drain();
+	}
+	if (dropped > 0)
+	{
+		fp = log_file();
+		fprintf(fp, "Log: %u records dropped\n", dropped);
+		fflush(fp);
+	}
+	if (own_file)
+		fclose(log_fp);
+	log_fp = NULL;
+	own_file = 0;
+}
+
+/* Reserves the next slot of the ring, or returns NULL (and counts a drop) when it is full */
+static struct log_record *reserve(void)
+{
+	unsigned h = atomic_load_explicit(&head, memory_order_relaxed);
+
+	if (h - atomic_load_explicit(&tail, memory_order_acquire) == LOG_SLOTS)
+	{
+		dropped++;
+		return NULL;
+	}
+	return &ring[h % LOG_SLOTS];
+}
+
+static void commit(void)
+{
+	atomic_fetch_add_explicit(&head, 1, memory_order_release);
+}
+
+void log_write(int level, const char *format, ...)
+{
+	struct log_record *r = reserve();
+	va_list args;
+	int len;
+
+	(void)level;
+	if (r == NULL)
+		return;
+	va_start(args, format);
+	len = vsnprintf(r->data.text, LOG_SLOTSIZE, format, args);
+	va_end(args);
+	r->kind = RECORD_TEXT;
+	r->len = (len < LOG_SLOTSIZE) ? len : LOG_SLOTSIZE - 1;
+	commit();
+	if (!started)
+		drain();
+}
+
+/**
+ * Logs a copy of the board of size squares, formatting happens on the writer thread
+ */
+void log_board(int level, const int *board, int size)
+{
+	struct log_record *r;
+
+	(void)level;
+	if (size * sizeof(int) > LOG_SLOTSIZE || (r = reserve()) == NULL)
+		return;
+	memcpy(r->data.board, board, size * sizeof(int));
+	r->kind = RECORD_BOARD;
+	r->len = size;
+	commit();
+	if (!started)
+		drain();
+}
@@ -0,0 +1,58 @@
+#ifndef _LOG_H
+#define _LOG_H
+
+#include <stdio.h>
+
+/**
+ * Asynchronous per-rank logger.
+ *
+ * The calling thread only copies the record into a lock-free single-producer,
+ * single-consumer ring buffer; a background thread formats it and writes it
+ * to the log file. When the ring is full the record is dropped instead of
+ * blocking the caller, and the number of dropped records is written at the end.
+ *
+ * Records above LOG_LEVEL are removed at compile time (make LOG_LEVEL=n).
+ */
+
+#define LOG_LEVEL_OFF 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+void log_init(FILE *fp, const char *filename, void (*printer)(FILE *fp, int *board));
+void log_finalize(void);
+void log_write(int level, const char *format, ...);
+void log_board(int level, const int *board, int size);
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) log_write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) log_write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) log_write(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_BOARD(board, size) log_board(LOG_LEVEL_INFO, board, size)
+#else
+#define LOG_INFO(...) ((void)0)
+#define LOG_BOARD(board, size) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) log_write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#endif
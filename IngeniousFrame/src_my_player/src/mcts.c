@@ -0,0 +1,514 @@
+#define _GNU_SOURCE // sched_getaffinity
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <mpi.h>
+#include "mcts.h"
+#include "bitboard.h"
+#include "playout.h"
+#include "stats.h"
+#include "log.h"
+
+#define MAX_PATH (2 * BOARD_CELLS + 2) // a move fills a square, and there is no second pass in a row
+
+enum node_state
+{
+	NODE_LEAF,		// children not known yet
+	NODE_EXPANDING, // a thread is adding the children
+	NODE_EXPANDED	// children are first_child .. first_child + nr_children - 1, none when the game is over
+};
+
+struct mcts_node
+{
+	int move;		 // bit of the move that led here, -1 for a pass
+	int first_child; // index in the pool
+	int nr_children;
+	atomic_int state;
+	atomic_int visits;	// playouts through the node, those still running included
+	atomic_llong wins;	// MCTS_WIN per playout won by the side that moved here, half for a draw
+};
+
+/* a searching thread: its own batch of playouts and the deepest leaf it reached */
+struct mcts_thread
+{
+	pthread_t id;
+	struct playout_batch batch;
+	int max_depth;
+};
+
+static struct mcts_node *nodes;
+static atomic_int nr_nodes;
+static atomic_int tree_full; // no more room for children, leaves stay leaves
+static atomic_int stop_threads;
+static atomic_llong playouts; // of all threads in this search, for its node limit
+static struct mcts_thread *threads;
+static int nr_threads;
+static bitboard root_own, root_opp;
+static int (*evaluate)(bitboard own, bitboard opp); // NULL for playouts to the end
+
+/* the root moves at the last merge, the part every rank already knows */
+static long long *merged;
+static long long *deltas;
+
+/* the cpus this rank may use, shared with the other ranks on its node */
+static int default_threads(void)
+{
+	MPI_Comm node;
+	cpu_set_t cpus;
+	int ranks, n = 1;
+
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+	MPI_Comm_size(node, &ranks);
+	MPI_Comm_free(&node);
+	if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+		n = CPU_COUNT(&cpus) / ranks;
+	return (n > 1) ? n : 1;
+}
+
+/**
+ * Allocates the tree and the threads of this rank, threads <= 0 for one per cpu of the rank.
+ * With an evaluation function the playouts stop after MCTS_ROLLOUT_PLIES moves and the
+ * evaluation of the position, for the side to move, gives their result; it is called by
+ * all threads at once. Not collective: every rank of the Monte Carlo engines calls it but
+ * main lets the ranks agree on a failure, the hybrid engine calls it on rank 0 only.
+ * Returns the number of threads, 0 when out of memory (nothing stays allocated then).
+ */
+int mcts_init(int threads_wanted, int (*evaluation)(bitboard own, bitboard opp))
+{
+	int rank, t;
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	evaluate = evaluation;
+	nr_threads = (threads_wanted > 0) ? threads_wanted : default_threads();
+	nodes = (struct mcts_node *)malloc(MCTS_NODES * sizeof(struct mcts_node));
+	threads = (struct mcts_thread *)calloc(nr_threads, sizeof(struct mcts_thread));
+	merged = (long long *)malloc(2 * (BOARD_CELLS + 1) * sizeof(long long));
+	deltas = (long long *)malloc(2 * 2 * (BOARD_CELLS + 1) * sizeof(long long));
+	if (nodes == NULL || threads == NULL || merged == NULL || deltas == NULL)
+	{
+		LOG_ERROR("no memory for the search tree\n");
+		mcts_free();
+		return 0;
+	}
+	for (t = 0; t < nr_threads; t++)
+	{
+		if (playout_batch_init(&threads[t].batch, PLAYOUT_LANES, ((uint64_t)rank << 32) + t) == 0)
+		{
+			LOG_ERROR("no memory for the search tree\n");
+			mcts_free();
+			return 0;
+		}
+	}
+	return nr_threads;
+}
+
+void mcts_free(void)
+{
+	int t;
+
+	for (t = 0; threads != NULL && t < nr_threads; t++)
+		playout_batch_free(&threads[t].batch);
+	free(nodes);
+	free(threads);
+	free(merged);
+	free(deltas);
+	nodes = NULL;
+	threads = NULL;
+	merged = deltas = NULL;
+}
+
+static void init_node(struct mcts_node *node, int move)
+{
+	node->move = move;
+	node->first_child = 0;
+	node->nr_children = 0;
+	atomic_init(&node->state, NODE_LEAF);
+	atomic_init(&node->visits, 0);
+	atomic_init(&node->wins, 0LL);
+}
+
+/* adds the children of leaf n, own to move; 0 if another thread does or there is no room */
+static int expand(int n, bitboard own, bitboard opp)
+{
+	struct mcts_node *node = &nodes[n];
+	int expected = NODE_LEAF;
+	bitboard moves = bb_moves(own, opp);
+	int count, first, i;
+
+	if (atomic_load(&tree_full) || !atomic_compare_exchange_strong(&node->state, &expected, NODE_EXPANDING))
+		return 0;
+	count = (moves != 0) ? bb_count(moves) : (bb_moves(opp, own) != 0); // a pass, or the end of the game
+	first = atomic_fetch_add(&nr_nodes, count);
+	if (first + count > MCTS_NODES)
+	{
+		atomic_store(&tree_full, 1);
+		atomic_store(&node->state, NODE_LEAF);
+		return 0;
+	}
+	for (i = 0; i < count; i++, moves &= moves - 1)
+		init_node(&nodes[first + i], (moves != 0) ? bb_first(moves) : -1);
+	node->first_child = first;
+	node->nr_children = count;
+	atomic_store_explicit(&node->state, NODE_EXPANDED, memory_order_release);
+	return 1;
+}
+
+/* the child of n with the highest upper confidence bound, a child not visited yet first */
+static int select_child(int n)
+{
+	const struct mcts_node *node = &nodes[n];
+	double log_visits = log(atomic_load(&node->visits) + 1);
+	double best_value = -1, value;
+	int best = node->first_child;
+	int c, visits;
+
+	for (c = node->first_child; c < node->first_child + node->nr_children; c++)
+	{
+		visits = atomic_load(&nodes[c].visits);
+		if (visits == 0)
+			return c;
+		value = atomic_load(&nodes[c].wins) / ((double)MCTS_WIN * visits) + MCTS_EXPLORATION * sqrt(log_visits / visits);
+		if (value > best_value)
+		{
+			best_value = value;
+			best = c;
+		}
+	}
+	return best;
+}
+
+/* the share of MCTS_WIN the side to move gets for a game ended at score, or evaluated at score */
+static long long result_of(int score, int over)
+{
+	if (over)
+		return (score > 0) ? MCTS_WIN : (score == 0) ? MCTS_WIN / 2 : 0;
+	return (long long)(MCTS_WIN / (1 + exp(-score / MCTS_EVAL_SCALE)) + 0.5);
+}
+
+/* PLAYOUT_LANES games from the position, own to move; returns their wins for own */
+static long long rollouts(struct playout_batch *batch, bitboard own, bitboard opp)
+{
+	long long wins = 0;
+	int l, ply;
+
+	for (l = 0; l < PLAYOUT_LANES; l++)
+		playout_set(batch, l, own, opp, 1);
+	if (evaluate == NULL)
+	{
+		playout_run(batch);
+		for (l = 0; l < PLAYOUT_LANES; l++)
+			wins += result_of(playout_score(batch, l, 1), 1);
+		return wins;
+	}
+
+	for (ply = 0; ply < MCTS_ROLLOUT_PLIES && playout_step(batch) > 0; ply++)
+		;
+	for (l = 0; l < PLAYOUT_LANES; l++)
+	{
+		if (batch->passes[l] >= 2)
+			wins += result_of(playout_score(batch, l, 1), 1);
+		else if (batch->colour[l] == 1)
+			wins += result_of(evaluate(batch->own[l], batch->opp[l]), 0);
+		else
+			wins += MCTS_WIN - result_of(evaluate(batch->own[l], batch->opp[l]), 0);
+	}
+	return wins;
+}
+
+/*
+ * Walks from the root to a leaf by UCT and adds visits to every node on the way, as losses
+ * until back_up or undo_visits. Returns the length of path; own and opp become the discs of
+ * the leaf, own to move.
+ */
+static int descend(int *path, bitboard *own, bitboard *opp, int visits)
+{
+	bitboard flips, swap;
+	int depth = 0, n = 0, c, expanded = 0;
+
+	*own = root_own;
+	*opp = root_opp;
+	for (;;)
+	{
+		atomic_fetch_add(&nodes[n].visits, visits);
+		path[depth++] = n;
+		if (expanded)
+			return depth; // the first child of a new node is the leaf
+		if (atomic_load_explicit(&nodes[n].state, memory_order_acquire) != NODE_EXPANDED)
+		{
+			if (depth >= MAX_PATH || !expand(n, *own, *opp))
+				return depth;
+			expanded = 1;
+		}
+		if (nodes[n].nr_children == 0)
+			return depth;
+
+		c = select_child(n);
+		if (nodes[c].move >= 0)
+		{
+			flips = bb_flips(nodes[c].move, *own, *opp);
+			*own |= flips | ((bitboard)1 << nodes[c].move);
+			*opp &= ~flips;
+		}
+		swap = *own;
+		*own = *opp;
+		*opp = swap;
+		n = c;
+	}
+}
+
+/* adds the wins of the side to move at the leaf of path, out of MCTS_WIN per visit, to its nodes */
+static void back_up(const int *path, int depth, long long wins, int visits)
+{
+	/* the leaf was reached by a move of the side not to move there */
+	wins = MCTS_WIN * visits - wins;
+	while (depth-- > 0)
+	{
+		atomic_fetch_add(&nodes[path[depth]].wins, wins);
+		wins = MCTS_WIN * visits - wins;
+	}
+}
+
+static void undo_visits(const int *path, int depth, int visits)
+{
+	while (depth-- > 0)
+		atomic_fetch_sub(&nodes[path[depth]].visits, visits);
+}
+
+/* one walk from the root to a leaf, PLAYOUT_LANES playouts from it and their results back up */
+static void iterate(struct mcts_thread *thread)
+{
+	int path[MAX_PATH];
+	bitboard own, opp;
+	int depth = descend(path, &own, &opp, PLAYOUT_LANES);
+
+	if (depth - 1 > thread->max_depth)
+		thread->max_depth = depth - 1;
+	back_up(path, depth, rollouts(&thread->batch, own, opp), PLAYOUT_LANES);
+	atomic_fetch_add(&playouts, PLAYOUT_LANES);
+}
+
+static void *thread_main(void *arg)
+{
+	struct mcts_thread *thread = (struct mcts_thread *)arg;
+
+	while (!atomic_load(&stop_threads))
+		iterate(thread);
+	return NULL;
+}
+
+/*
+ * Adds the visits and wins of the root moves that the other ranks found since the last
+ * merge. Returns 1 when stop is set on any rank.
+ */
+static int merge_root(int stop)
+{
+	const struct mcts_node *root = &nodes[0];
+	long long *local = deltas, *total = deltas + 2 * (BOARD_CELLS + 1);
+	int n = root->nr_children, i, c;
+	long long others;
+
+	for (i = 0; i < n; i++)
+	{
+		c = root->first_child + i;
+		local[2 * i] = atomic_load(&nodes[c].visits) - merged[2 * i];
+		local[2 * i + 1] = atomic_load(&nodes[c].wins) - merged[2 * i + 1];
+	}
+	local[2 * n] = stop;
+	STATS_MPI(MPI_Allreduce(local, total, 2 * n + 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD));
+	for (i = 0; i < n; i++)
+	{
+		c = root->first_child + i;
+		others = total[2 * i] - local[2 * i];
+		atomic_fetch_add(&nodes[c].visits, (int)others);
+		atomic_fetch_add(&nodes[0].visits, (int)others);
+		atomic_fetch_add(&nodes[c].wins, total[2 * i + 1] - local[2 * i + 1]);
+		merged[2 * i] += total[2 * i];
+		merged[2 * i + 1] += total[2 * i + 1];
+	}
+	return total[2 * n] > 0;
+}
+
+/* the tree of the position with the discs own of the side to move and opp of the other side */
+static void new_tree(bitboard own, bitboard opp)
+{
+	root_own = own;
+	root_opp = opp;
+	atomic_store(&nr_nodes, 1);
+	atomic_store(&tree_full, 0);
+	init_node(&nodes[0], -1);
+	expand(0, own, opp);
+}
+
+/* the root move with the most visits */
+static void best_move(struct mcts_result *result)
+{
+	const struct mcts_node *root = &nodes[0];
+	int best = root->first_child, c;
+
+	if (root->nr_children == 0)
+	{
+		result->move = -1;
+		result->value = 0.5;
+		return;
+	}
+	for (c = root->first_child; c < root->first_child + root->nr_children; c++)
+	{
+		if (atomic_load(&nodes[c].visits) > atomic_load(&nodes[best].visits))
+			best = c;
+	}
+	result->move = nodes[best].move;
+	result->value = (atomic_load(&nodes[best].visits) > 0)
+						? atomic_load(&nodes[best].wins) / ((double)MCTS_WIN * atomic_load(&nodes[best].visits))
+						: 0.5;
+}
+
+/**
+ * Searches the position with the discs own of the side to move and opp of the other side
+ * until stopped() returns 1 on a rank, and returns the root move with the most playouts
+ * of all ranks. Collective: every rank calls it with the same position. stopped is only
+ * called by the calling thread.
+ */
+void mcts_search(bitboard own, bitboard opp, int (*stopped)(void), struct mcts_result *result)
+{
+	const struct mcts_node *root = &nodes[0];
+	double next_merge = MPI_Wtime() + MCTS_MERGE_SECONDS;
+	int t;
+
+	new_tree(own, opp);
+	atomic_store(&stop_threads, 0);
+	memset(merged, 0, 2 * root->nr_children * sizeof(long long));
+	atomic_store(&playouts, 0LL);
+	for (t = 0; t < nr_threads; t++)
+		threads[t].max_depth = 0;
+
+	/* the same on every rank, no merge needed */
+	if (root->nr_children <= 1)
+	{
+		best_move(result);
+		result->playouts = 0;
+		result->max_depth = 0;
+		return;
+	}
+
+	for (t = 1; t < nr_threads; t++)
+	{
+		if (pthread_create(&threads[t].id, NULL, thread_main, &threads[t]) != 0)
+		{
+			LOG_WARN("search thread %d could not be started\n", t);
+			break;
+		}
+	}
+	nr_threads = t;
+	for (;;)
+	{
+		iterate(&threads[0]);
+		stats.nodes = atomic_load(&playouts); // of all threads, for the node limit of stopped
+		if (stopped() || MPI_Wtime() >= next_merge)
+		{
+			if (merge_root(stopped()))
+				break;
+			next_merge += MCTS_MERGE_SECONDS;
+		}
+	}
+	atomic_store(&stop_threads, 1);
+	for (t = 1; t < nr_threads; t++)
+		pthread_join(threads[t].id, NULL);
+
+	best_move(result);
+	result->playouts = atomic_load(&playouts);
+	result->max_depth = 0;
+	for (t = 0; t < nr_threads; t++)
+		if (threads[t].max_depth > result->max_depth)
+			result->max_depth = threads[t].max_depth;
+	stats.nodes = result->playouts;
+	stats.leaf_evals = result->playouts;
+	stats.max_depth = result->max_depth;
+}
+
+/*
+ * The tree of a search whose leaves are evaluated elsewhere, e.g. by other ranks: the
+ * caller takes leaves with mcts_select, evaluates them in any order and returns their
+ * scores with mcts_update. Only the thread that called mcts_start may call these.
+ */
+
+/* the leaves given out and not yet returned */
+static struct pending_leaf
+{
+	int path[MAX_PATH];
+	int depth; // 0 when the slot is free
+} pending[MCTS_PENDING];
+static long long leaves_done;
+static int leaves_max_depth;
+
+/**
+ * Starts the tree of the position with the discs own of the side to move and opp of the
+ * other side, on this rank alone. Returns the number of root moves, the pass included.
+ */
+int mcts_start(bitboard own, bitboard opp)
+{
+	int i;
+
+	new_tree(own, opp);
+	for (i = 0; i < MCTS_PENDING; i++)
+		pending[i].depth = 0;
+	leaves_done = 0;
+	leaves_max_depth = 0;
+	return nodes[0].nr_children;
+}
+
+/**
+ * Walks down to the next leaf to evaluate, which counts as a loss until its score is in.
+ * Leaves where the game is over are scored on the way. Returns the leaf's number and sets
+ * own and opp to its discs, own to move; -1 when MCTS_PENDING leaves are out, or when only
+ * finished games were found.
+ */
+int mcts_select(bitboard *own, bitboard *opp)
+{
+	struct pending_leaf *leaf;
+	int i, tries;
+
+	for (i = 0; i < MCTS_PENDING && pending[i].depth > 0; i++)
+		;
+	if (i == MCTS_PENDING)
+		return -1;
+	leaf = &pending[i];
+	for (tries = 0; tries < MCTS_PENDING; tries++)
+	{
+		leaf->depth = descend(leaf->path, own, opp, 1);
+		if (leaf->depth - 1 > leaves_max_depth)
+			leaves_max_depth = leaf->depth - 1;
+		if (nodes[leaf->path[leaf->depth - 1]].nr_children > 0 ||
+			atomic_load(&nodes[leaf->path[leaf->depth - 1]].state) != NODE_EXPANDED)
+			return i;
+		back_up(leaf->path, leaf->depth, result_of(bb_count(*own) - bb_count(*opp), 1), 1);
+		leaves_done++;
+	}
+	leaf->depth = 0;
+	return -1;
+}
+
+/* score of leaf for the side to move there, in the units of the evaluation function */
+void mcts_update(int leaf, int score)
+{
+	back_up(pending[leaf].path, pending[leaf].depth, result_of(score, 0), 1);
+	pending[leaf].depth = 0;
+	leaves_done++;
+}
+
+/* leaf was not evaluated, e.g. its search was cut short: it leaves the tree as it was */
+void mcts_cancel(int leaf)
+{
+	undo_visits(pending[leaf].path, pending[leaf].depth, 1);
+	pending[leaf].depth = 0;
+}
+
+/* the root move with the most visits, after the leaves given out are back */
+void mcts_result(struct mcts_result *result)
+{
+	best_move(result);
+	result->playouts = leaves_done;
+	result->max_depth = leaves_max_depth;
+}
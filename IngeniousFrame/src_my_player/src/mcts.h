@@ -0,0 +1,53 @@
+#ifndef _MCTS_H
+#define _MCTS_H
+
+#include "board.h"
+
+/**
+ * Monte Carlo tree search (UCT), the engine of my_player --engine mcts.
+ *
+ * Every rank grows a tree of its own from the root position. Inside a rank the threads
+ * share the tree (tree parallelism): a thread walks down to a leaf by UCT, expands it and
+ * plays PLAYOUT_LANES random games from it as one batch (playout.h), to the end or, with an
+ * evaluation function, for MCTS_ROLLOUT_PLIES moves and then evaluated. On the way down the
+ * visits of those games are counted at once, as losses until their results come back
+ * (virtual loss), which sends the other threads down other paths. Across the ranks the
+ * trees are only joined at the root (root parallelism): every MCTS_MERGE_SECONDS the ranks
+ * add up what they learned about each root move since the last merge, and every rank adds
+ * the others' share to its own root.
+ *
+ * The search ends at the merge after the stop function of the main thread returned 1 on
+ * any rank, so all ranks take part in the same merges.
+ *
+ * mcts_start, mcts_select and mcts_update grow a tree on one rank whose leaves are scored
+ * by the caller instead, e.g. by shallow alpha-beta searches on the other ranks: several
+ * leaves can be out at once, and their scores can come back in any order.
+ */
+
+#define MCTS_NODES (1 << 20)	  // nodes of the tree of a rank, 32 bytes each
+#define MCTS_MERGE_SECONDS 0.1	  // between two merges of the root moves of all ranks
+#define MCTS_EXPLORATION 0.7	  // weight of the exploration term of UCT
+#define MCTS_ROLLOUT_PLIES 4	  // random moves of a playout before it is evaluated
+#define MCTS_EVAL_SCALE 100.0	  // evaluation at which a playout counts as 73% won (logistic)
+#define MCTS_WIN 64				  // a playout won, in the units of the win counts
+#define MCTS_PENDING 256		  // leaves of mcts_select out at once
+
+struct mcts_result
+{
+	int move;			 // bit of the move (bitboard.h), -1 for a pass
+	long long playouts;	 // games played by the threads of this rank, or leaves scored
+	int max_depth;		 // deepest node reached below the root
+	double value;		 // share of the move's playouts won, a draw counts half, on all ranks
+};
+
+int mcts_init(int threads, int (*evaluate)(bitboard own, bitboard opp));
+void mcts_free(void);
+void mcts_search(bitboard own, bitboard opp, int (*stopped)(void), struct mcts_result *result);
+
+int mcts_start(bitboard own, bitboard opp);
+int mcts_select(bitboard *own, bitboard *opp);
+void mcts_update(int leaf, int score);
+void mcts_cancel(int leaf);
+void mcts_result(struct mcts_result *result);
+
+#endif
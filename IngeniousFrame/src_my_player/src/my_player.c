@@ -24,6 +24,17 @@
  *        .
  *        N. A player makes the final move and "game_over" is called for both players
  *
+ *    Started as "my_player --stdio [filename]" the engine reads text commands from
+ *    stdin instead (position, go, stop, stats, see run_text_master), and as
+ *    "my_player --analyse [depth n] [nodes n] [file]" it analyses a file of positions
+ *    (see run_analysis); "my_player --blunders [...] files" checks finished games (see run_blunders),
+ *    "my_player --book [...]" builds the opening book (see run_book) and "my_player --solve [...]"
+ *    solves the game from the initial position (see run_solve).
+ *    "my_player --daemon <ip> <port> <time_limit> <filename>" stays running after game_over
+ *    and plays the next game of the referee, see run_master.
+ *    "my_player --engine mcts|mcts-eval|mcts-ab [...]" searches with Monte Carlo tree search (mcts.h)
+ *    instead of alpha-beta in any of these modes but the analysis ones, see select_engine.
+ *
  *    IMPORTANT NOTE:
  *        Write any (debugging) output you would like to see to a file.
  *        	- This can be done using file fp, and fprintf()
@@ -41,122 +52,505 @@
 #include <time.h>
 #include <assert.h>
 #include "comms.h"
+#include "board.h"
+#include "stats.h"
+#include "trace.h"
+#include "perfctr.h"
+#include "log.h"
+#include "textproto.h"
+#include "gamerec.h"
+#include "tt.h"
+#include "experience.h"
+#include "book.h"
+#include "symmetry.h"
+#include "bitboard.h"
+#include "playout.h"
+#include "mcts.h"
 #include <limits.h>
 
 const int EMPTY = 0;
 const int BLACK = 1;
 const int WHITE = 2;
 const int OUTER = 3;
+const int SCORE_INF = INT_MAX; // bound of the search window, -SCORE_INF is still an int
 
-const int ALLDIRECTIONS[8] = {-11, -10, -9, -1, 1, 9, 10, 11};
-const int BOARDSIZE = 100;
+const int BOARDSIZE = BOARD_INTS; // the mailbox and the bitboards after it (board.h)
 
-const int LEGALMOVSBUFSIZE = 65;
+const int LEGALMOVSBUFSIZE = BOARD_CELLS + 1;
 const char piecenames[4] = {'.', 'b', 'w', '?'};
 
 const double TIME_OFFSET = 0.3; // variable used in time calculation
 const int DEPTH = 5;			// Depth of the minimax algorithm
+const int STOP_CHECK_NODES = 1024; // nodes between two checks for a stop command
+const int SOLVE_DEPTH = 127;		// depth of the exact transposition table entries (solve.h), deeper than any search
+const int SOLVE_SORT_EMPTIES = 6;	// the solver orders the moves fastest first above this many empty squares
+const int MCTS_PLAYOUTS_PER_PLY = 10000; // a Monte Carlo search without a time limit plays this many playouts per ply of depth
+const int MCTS_LEAF_DEPTH = 2;			 // depth of the alpha-beta search of a leaf of the hybrid search
+const int MCTS_LEAVES_PER_WORKER = 2;	 // leaves sent to a worker at once, so that the next one is waiting
+const int MCTS_LEAVES_PER_PLY = 500;	 // a hybrid search without a time limit scores this many leaves per ply of depth
+const char *EXPERIENCE_FILE = "experience" BOARD_SUFFIX ".bin"; // see experience.h, in the working directory
+const char *BOOK_FILE = "book" BOARD_SUFFIX ".bin";				// see book.h, in the working directory
+
+/* the search of every move, chosen at start-up (see main) */
+enum engine
+{
+	ENGINE_ALPHABETA, // negamax of the root moves, split over the ranks
+	ENGINE_MCTS,	  // Monte Carlo tree search (mcts.h) with random playouts to the end
+	ENGINE_MCTS_EVAL, // Monte Carlo tree search with short playouts scored by the evaluation
+	ENGINE_MCTS_AB	  // Monte Carlo tree search on rank 0 whose leaves the workers score with alpha-beta
+};
+
+/* what the workers do next */
+enum job_kind
+{
+	JOB_QUIT,	  // the workers have to finish
+	JOB_SEARCH,	  // take part in the search of the board broadcast next
+	JOB_ANALYSE,  // analyse the positions sent by rank 0 until it sends index -1 (see analyse_worker)
+	JOB_LOAD,	  // add the experience entries broadcast next to the transposition table
+	JOB_SAVE	  // send the deep transposition table entries to rank 0 (see save_experience)
+};
+
+/* a search job, broadcast by rank 0 before the board */
+enum job_field
+{
+	JOB_KIND,	   // see job_kind
+	JOB_COLOUR,	   // side to move
+	JOB_DEPTH,	   // depth of the search
+	JOB_TIME_MS,   // time limit in milliseconds, 0 for none
+	JOB_STOPPABLE, // rank 0 may stop the search early (stdio mode)
+	JOB_SIZE
+};
+
+/* message tags of the point-to-point messages used by a stoppable search */
+enum search_tag
+{
+	TAG_STOP = 1, // rank 0 to the workers: stop searching
+	TAG_DONE,	  // rank 0 to the workers: no more stop messages for this search
+	TAG_ANALYSE,  // rank 0 to a worker: a position to analyse
+	TAG_RESULT,	  // a worker to rank 0: the analysis of that position
+	TAG_LEAF,	  // rank 0 to a worker: a leaf of the hybrid search to score
+	TAG_LEAF_SCORE // a worker to rank 0: the score of that leaf
+};
+
+/* layout of the TAG_LEAF message, followed by the board with black to move */
+enum leaf_field
+{
+	LEAF_INDEX, // leaf number of mcts_select, -1 when the search is over
+	LEAF_SIZE
+};
+
+/* layout of the TAG_LEAF_SCORE message */
+enum leaf_score_field
+{
+	LEAF_SCORE_INDEX,
+	LEAF_SCORE_SCORE,	// for black, the side to move
+	LEAF_SCORE_STOPPED, // the search was cut short, the score is not used
+	LEAF_SCORE_SIZE
+};
+
+/* layout of the TAG_ANALYSE message, followed by the board */
+enum analyse_field
+{
+	ANALYSE_INDEX, // position number, -1 when there are no more positions
+	ANALYSE_COLOUR,
+	ANALYSE_DEPTH,	// 0 to solve the position exactly
+	ANALYSE_NODES_HIGH, // node budget, 0 for none: the bits above the lowest 31
+	ANALYSE_NODES_LOW,	// and the lowest 31 bits, an int holds only part of a long long
+	ANALYSE_PLAYED, // move made in the game, -1 if none
+	ANALYSE_SIZE
+};
+
+/* layout of the TAG_RESULT message (long long), followed by the principal variation */
+enum result_field
+{
+	RESULT_INDEX,
+	RESULT_MOVE, // best move, -1 to pass
+	RESULT_SCORE,
+	RESULT_DEPTH, // depth of the last complete iteration
+	RESULT_NODES,
+	RESULT_PLAYED_SCORE, // score of the move made in the game
+	RESULT_PV_LENGTH,
+	RESULT_SIZE
+};
+
+/* a position of the analysis or blunder mode, in input order */
+struct analysis
+{
+	char *label;  // start of the output line: line number, or file and move number
+	int played;	  // move made in the game, -1 in the analysis mode
+	char *output; // the result line, "" for none, NULL while the position is being analysed
+};
+
+/* rank 0: the positions of an analysis, see queue_init */
+struct analysis_queue
+{
+	struct analysis *positions;
+	int capacity;
+	int nr_added;	// positions added
+	int nr_written; // positions written, in input order
+	int in_flight;	// positions sent to a worker
+	int *busy;		// busy[r]: worker r is analysing a position
+	int *msg;		// TAG_ANALYSE message
+	int depth;
+	long long nodes;
+	int threshold;	 // blunder mode: report moves that lose at least this much
+	int nr_checked;	 // blunder mode: moves analysed
+	int nr_blunders; // blunder mode: moves reported
+	FILE *out;		 // where the results are written, stdout unless the book builder sets it
+};
+
+/* a position of the opening tree of the book builder, see run_book */
+struct book_node
+{
+	uint64_t key; // tt_hash, 0 marks a free slot
+	int expanded; // seen by expand_book
+	int scored;	  // score is known: a leaf that was analysed, or an inner position that was backed up
+	int backed_up;
+	int score;	  // from the side to move
+	int leaves;	  // leaves below the position, for the counts of the book
+};
+
+/* open addressing table of the book_nodes, the size is a power of 2 */
+struct node_map
+{
+	struct book_node *nodes;
+	int capacity;
+	int size;
+};
 
 /////////////////////constants used in the stability evaluation of the minmax algorithm
 const int CORNER_WEIGHT = 4;
 const int EDGE_WEIGHT = 2;
 const int INTERIOR_WEIGHT = 1;
+
+/* stability weight of every square of the mailbox, the border squares are 0 */
+#if BOARD_N == 6
+static const int s_weights[BOARD_SQUARES] = {
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 4, -3, 2, 2, -3, 4, 0,
+	0, -3, -4, -1, -1, -4, -3, 0,
+	0, 2, -1, 1, 1, -1, 2, 0,
+	0, 2, -1, 1, 1, -1, 2, 0,
+	0, -3, -4, -1, -1, -4, -3, 0,
+	0, 4, -3, 2, 2, -3, 4, 0,
+	0, 0, 0, 0, 0, 0, 0, 0};
+#elif BOARD_N == 8
+static const int s_weights[BOARD_SQUARES] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 4, -3, 2, 2, 2, 2, -3, 4, 0,
+	0, -3, -4, -1, -1, -1, -1, -4, -3, 0,
+	0, 2, -1, 1, 0, 0, 1, -1, 2, 0,
+	0, 2, -1, 0, 1, 1, 0, -1, 2, 0,
+	0, 2, -1, 0, 1, 1, 0, -1, 2, 0,
+	0, 2, -1, 1, 0, 0, 1, -1, 2, 0,
+	0, -3, -4, -1, -1, -1, -1, -4, -3, 0,
+	0, 4, -3, 2, 2, 2, 2, -3, 4, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+#else
+static const int s_weights[BOARD_SQUARES] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 4, -3, 2, 2, 2, 2, 2, 2, -3, 4, 0,
+	0, -3, -4, -1, -1, -1, -1, -1, -1, -4, -3, 0,
+	0, 2, -1, 1, 0, 0, 0, 0, 1, -1, 2, 0,
+	0, 2, -1, 0, 1, 0, 0, 1, 0, -1, 2, 0,
+	0, 2, -1, 0, 0, 1, 1, 0, 0, -1, 2, 0,
+	0, 2, -1, 0, 0, 1, 1, 0, 0, -1, 2, 0,
+	0, 2, -1, 0, 1, 0, 0, 1, 0, -1, 2, 0,
+	0, 2, -1, 1, 0, 0, 0, 0, 1, -1, 2, 0,
+	0, -3, -4, -1, -1, -1, -1, -1, -1, -4, -3, 0,
+	0, 4, -3, 2, 2, 2, 2, 2, 2, -3, 4, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+#endif
 /////////////////////
 
-void run_master(int argc, char *argv[]);
-int initialise_master(int argc, char *argv[], int *time_limit, int *my_colour, FILE **fp);
-void gen_move_master(char *move, int my_colour, FILE *fp);
+void run_master(int argc, char *argv[], int daemon);
+void play_game(int my_colour, FILE *fp);
+void run_text_master(int argc, char *argv[]);
+void run_analysis(int argc, char *argv[]);
+void run_blunders(int argc, char *argv[]);
+void run_book(int argc, char *argv[]);
+void run_solve(int argc, char *argv[]);
+void run_perft(int argc, char *argv[]);
+void run_playouts(int argc, char *argv[]);
+long long perft(int colour, int depth, int passed);
+int read_checkpoint(struct node_map *map, const char *filename);
+void expand_book(struct node_map *map, struct analysis_queue *queue, int colour, int ply, int plies);
+int back_up(struct node_map *map, int colour, int ply, int plies, struct book_entry **entries, int *n, int *capacity);
+FILE *open_checkpoint(const char *filename);
+struct book_node *find_node(struct node_map *map, uint64_t key);
+long long node_budget(const char *arg);
+void queue_init(struct analysis_queue *queue, int depth, long long nodes, int threshold);
+struct analysis *queue_append(struct analysis_queue *queue, const char *label, int played);
+void queue_add(struct analysis_queue *queue, const char *label, int colour, int played);
+void queue_add_line(struct analysis_queue *queue, const char *label, const char *error);
+void queue_finish(struct analysis_queue *queue);
+void collect_analysis(struct analysis_queue *queue);
+void write_analysis(struct analysis_queue *queue);
+char *format_analysis(struct analysis_queue *queue, const struct analysis *a, const long long *result);
+void analyse_worker(void);
+void analyse(int colour, int depth, long long node_limit, int played, long long *result);
+void solve_position(int colour, long long *result);
+int set_position(char *token, char **save, int *colour, char *error, int size);
+int initialise_master(int argc, char *argv[], double *time_limit, int *my_colour, FILE **fp, int game_nr);
+int connect_referee(char *argv[], int game_nr, int *my_colour);
+int search_master(char *move, int colour, int depth, double limit, int stoppable, FILE *fp);
+void stop_workers(void);
+void load_experience(void);
+void save_experience(void);
+void broadcast_entries(struct tt_entry *entries, int n);
+int experience_move(char *move, int colour);
+int book_move(char *move, int colour);
+void start_search(const int *job);
+int search_stopped(void);
+void end_search(void);
+int gen_move_master(char *move, int my_colour, FILE *fp);
+int mcts_master(char *move, int my_colour, FILE *fp);
+int mcts_move(int colour, double *value);
+void hybrid_master(int colour, struct mcts_result *result);
+void hybrid_worker(void);
+int leaf_score(bitboard own, bitboard opp, int *stopped);
+void set_board_bitboards(int *b, bitboard black, bitboard white);
+int select_engine(int *argc, char ***argv);
 void apply_opp_move(char *move, int my_colour, FILE *fp);
 void game_over(void);
 void run_worker(int rank);
 void initialise_board(void);
 void free_board(void);
+char *output_filename(const char *log_filename, const char *suffix);
 
 void legal_moves(int player, int *moves, FILE *fp);
 int legalp(int move, int player, FILE *fp);
+int any_move(int player);
 int validp(int move);
-int would_flip(int move, int dir, int player, FILE *fp);
 int opponent(int player, FILE *fp);
-int find_bracket_piece(int square, int dir, int player, FILE *fp);
 void make_move(int move, int player, FILE *fp);
-void make_flips(int move, int dir, int player, FILE *fp);
 int get_loc(char *movestring);
+int move_square(const char *movestring);
 void get_move_string(int loc, char *ms);
-void print_board(FILE *fp);
+void print_board(FILE *fp, int *board);
 char nameof(int piece);
 int count(int player, int *board);
 
-int minimax(int loc, int my_colour, int depth, int alpha, int beta, int MaximisingPlayer);
+int negamax(int colour, int depth, int alpha, int beta);
+int negamax_black(int depth, int alpha, int beta);
+int negamax_white(int depth, int alpha, int beta);
+int solve_black(int alpha, int beta, int ply, int empties, int passed);
+int solve_white(int alpha, int beta, int ply, int empties, int passed);
+int final_score(bitboard own, bitboard opp);
+void order_fastest_first(int *moves, bitboard own, bitboard opp, int from);
+void update_pv(int ply, int move);
+int probe_node(uint64_t key, int depth, int alpha, int beta, int *score, int *move);
+void store_node(uint64_t key, int sym, int depth, int score, int alpha, int beta, int move, int tt_move, int ply);
+void order_moves(int *moves, int tt_move, int ply);
 int updated_evaluation(int my_colour); // updated version of evaluate_board function for better decision making in the minimax algorithm
+int evaluate_bitboards(bitboard own, bitboard opp);
 int min(int x, int y);
 int max(int x, int y);
 
 int *board;
-/////////////////////used in debugging the program
-FILE *fptr_debug0;
-FILE *fptr_debug1;
-FILE *fptr_debug2;
-FILE *fptr_debug3;
-/////////////////////
+char debug_filename[32]; // log file of the worker ranks, only created when they log something
+FILE *fptr_stats;	  // per-move search statistics, written by rank 0 only
+char *trace_filename; // timeline of all ranks, written by rank 0 only when built with TRACE
+char *game_filename;  // binary record of the game (gamerec.h), written by rank 0 at the end
 
 int nr_of_procs; // global variable to store number of || processes
-int time_limit;
+int my_rank;
+double time_limit; // seconds per move given by the referee
 double start_time; // variable used in time calculation
+int use_experience; // rank 0: the experience file is mapped, see load_experience
+int engine;			// see enum engine, the same on every rank
+
+/////////////////////state of the current search, set by start_search on every rank
+int search_depth;		  // depth of the root moves' subtrees
+double search_time_limit; // seconds, 0 for no limit
+int search_stoppable;	  // rank 0 polls stdin for stop, the workers poll for TAG_STOP
+long long search_node_limit; // stop after this many nodes, 0 for no limit
+int stop_search;		  // the search has to return as soon as possible
+/////////////////////
+
+/* principal variation of every ply of the last negamax call: pv[ply][0..pv_length[ply]) */
+int pv[STATS_MAX_PLY + 1][STATS_MAX_PLY];
+int pv_length[STATS_MAX_PLY + 1];
 
 int main(int argc, char *argv[])
 {
 	int rank;
+	int provided;
+	int tree_ok;
 
-	MPI_Init(&argc, &argv);
+	/* only the main thread calls MPI, the logger runs in a thread of its own */
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 	MPI_Comm_size(MPI_COMM_WORLD, &nr_of_procs); // get the number of parallel processes
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);		 // get the id of each || process
+	my_rank = rank;
 
-	fptr_debug0 = fopen("debug0.txt", "w");
-	fptr_debug1 = fopen("debug1.txt", "w");
-	fptr_debug2 = fopen("debug2.txt", "w");
-	fptr_debug3 = fopen("debug3.txt", "w");
+	TRACE_INIT();
+	PERF_INIT();
+	bb_init(); // the fastest move generation of the cpu
+	playout_init();
 
 	initialise_board(); // one for each process
+	tt_init();
+	engine = select_engine(&argc, &argv);
+	if (engine == ENGINE_MCTS_AB && rank == 0 && mcts_init(1, NULL) == 0)
+		MPI_Abort(MPI_COMM_WORLD, 1); // the workers do not know
+	if (engine == ENGINE_MCTS || engine == ENGINE_MCTS_EVAL)
+	{
+		/* the ranks of the two engines talk differently, so all of them fall back to alpha-beta if one has to */
+		tree_ok = mcts_init(0, (engine == ENGINE_MCTS_EVAL) ? evaluate_bitboards : NULL) > 0;
+		MPI_Allreduce(MPI_IN_PLACE, &tree_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+		if (!tree_ok)
+		{
+			mcts_free();
+			engine = ENGINE_ALPHABETA;
+		}
+	}
 
-	if (rank == 0)
+	if (rank == 0 && argc >= 2 && strcmp(argv[1], "--stdio") == 0)
+	{
+		run_text_master(argc, argv);
+	}
+	else if (rank == 0 && argc >= 2 && strcmp(argv[1], "--analyse") == 0)
+	{
+		run_analysis(argc, argv);
+	}
+	else if (rank == 0 && argc >= 2 && strcmp(argv[1], "--blunders") == 0)
+	{
+		run_blunders(argc, argv);
+	}
+	else if (rank == 0 && argc >= 2 && strcmp(argv[1], "--book") == 0)
+	{
+		run_book(argc, argv);
+	}
+	else if (rank == 0 && argc >= 2 && strcmp(argv[1], "--solve") == 0)
+	{
+		run_solve(argc, argv);
+	}
+	else if (rank == 0 && argc >= 2 && strcmp(argv[1], "--perft") == 0)
+	{
+		run_perft(argc, argv);
+	}
+	else if (rank == 0 && argc >= 2 && strcmp(argv[1], "--playouts") == 0)
+	{
+		run_playouts(argc, argv);
+	}
+	else if (rank == 0 && argc >= 2 && strcmp(argv[1], "--daemon") == 0)
+	{
+		run_master(argc - 1, argv + 1, 1);
+	}
+	else if (rank == 0)
 	{
-		run_master(argc, argv);
+		run_master(argc, argv, 0);
 	}
 	else
 	{
+		snprintf(debug_filename, sizeof(debug_filename), "debug%d.txt", rank);
+		log_init(NULL, debug_filename, print_board);
 		run_worker(rank);
 	}
 	game_over();
 }
 
-void run_master(int argc, char *argv[])
+/**
+ *   Every rank: the engine asked for by "--engine alphabeta|mcts|mcts-eval|mcts-ab" in front of
+ *   the other arguments, which are then removed, or else by the name of the program, so that the
+ *   referee can start a Monte Carlo player as my_player_mcts, my_player_mcts_eval or my_player_mcts_ab.
+ */
+int select_engine(int *argc, char ***argv)
 {
-	// fprintf(fptr_debug0, "Hello from Proc 0\n");
+	const char *name = strrchr((*argv)[0], '/');
+	int chosen;
 
-	char cmd[CMDBUFSIZE];
-	char my_move[MOVEBUFSIZE];
-	char opponent_move[MOVEBUFSIZE];
+	name = (name != NULL) ? name + 1 : (*argv)[0];
+	if (*argc < 3 || strcmp((*argv)[1], "--engine") != 0)
+	{
+		if (strstr(name, "mcts_eval") != NULL)
+			return ENGINE_MCTS_EVAL;
+		if (strstr(name, "mcts_ab") != NULL)
+			return ENGINE_MCTS_AB;
+		return (strstr(name, "mcts") != NULL) ? ENGINE_MCTS : ENGINE_ALPHABETA;
+	}
+
+	if (strcmp((*argv)[2], "mcts") == 0)
+		chosen = ENGINE_MCTS;
+	else if (strcmp((*argv)[2], "mcts-eval") == 0)
+		chosen = ENGINE_MCTS_EVAL;
+	else if (strcmp((*argv)[2], "mcts-ab") == 0)
+		chosen = ENGINE_MCTS_AB;
+	else
+	{
+		if (strcmp((*argv)[2], "alphabeta") != 0 && my_rank == 0)
+			fprintf(stderr, "Unknown engine %s, alphabeta is used\n", (*argv)[2]);
+		chosen = ENGINE_ALPHABETA;
+	}
+	(*argv)[2] = (*argv)[0];
+	*argv += 2;
+	*argc -= 2;
+	return chosen;
+}
+
+/**
+ *   Rank 0 plays the games of the referee: one game, or in daemon mode one game per
+ *   connection, reconnecting to the same port after every game_over until the referee
+ *   is gone. The workers stay in run_worker between the games.
+ */
+void run_master(int argc, char *argv[], int daemon)
+{
 	int my_colour;
-	int running = 0;
+	int game_nr = daemon ? 1 : 0;
+	int connected;
 	FILE *fp = NULL;
 
-	if (initialise_master(argc, argv, &time_limit, &my_colour, &fp) != FAILURE)
+	connected = (initialise_master(argc, argv, &time_limit, &my_colour, &fp, game_nr) != FAILURE);
+	LOG_DEBUG("Hello from Proc 0\n");
+
+	while (connected)
 	{
-		running = 1;
+		if (daemon)
+			LOG_INFO("Game %d\n", game_nr);
+		play_game(my_colour, fp);
+		if (!daemon)
+			break;
+
+		comms_close();
+		free_board();
+		initialise_board();
+		connected = (connect_referee(argv, ++game_nr, &my_colour) != FAILURE);
+		if (!connected)
+			LOG_INFO("No referee to connect to, %d games played\n", game_nr - 1);
 	}
+
+	stop_workers();
+}
+
+/**
+ *   Plays one game against the referee, then writes the game summary of the
+ *   statistics and the game record
+ */
+void play_game(int my_colour, FILE *fp)
+{
+	char cmd[CMDBUFSIZE];
+	char my_move[MOVEBUFSIZE];
+	char opponent_move[MOVEBUFSIZE];
+	int running = 1;
+	int move_nr = 0;
+	int searched;
+	int result;
+	struct game_record record;
+
 	if (my_colour == EMPTY)
 		my_colour = BLACK;
-
-	/*Broadcast my_colour to every process*/
-	MPI_Bcast(&my_colour, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	gamerec_init(&record, my_colour, BOARD_N);
 
 	while (running == 1)
 	{
 		/* Receive next command from referee */
-		if (comms_get_cmd(cmd, opponent_move) == FAILURE)
+		TRACE_BEGIN(TRACE_COMMS_WAIT, -1);
+		result = comms_get_cmd(cmd, opponent_move);
+		TRACE_END(TRACE_COMMS_WAIT);
+		if (result == FAILURE)
 		{
-			fprintf(fp, "Error getting cmd\n");
-			fflush(fp);
+			LOG_ERROR("Error getting cmd\n");
 			running = 0;
 			break;
 		}
@@ -165,29 +559,39 @@ void run_master(int argc, char *argv[])
 		if (strcmp(cmd, "game_over") == 0)
 		{
 			running = 0;
-			fprintf(fp, "Game over\n");
-			fflush(fp);
+			LOG_INFO("Game over\n");
 			break;
 
 			/* Received gen_move message */
 		}
 		else if (strcmp(cmd, "gen_move") == 0)
 		{
-			//*Broadcast running to every process*/
-			MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-			//*Broadcast board to every process*/
-			MPI_Bcast(board, BOARDSIZE, MPI_INT, 0, MPI_COMM_WORLD);
-
-			gen_move_master(my_move, my_colour, fp);
-
-			print_board(fp);
-
-			if (comms_send_move(my_move) == FAILURE)
+			move_nr++;
+			/* the book and the experience file hold alpha-beta results, the Monte Carlo engines search every move */
+			searched = (engine != ENGINE_ALPHABETA ||
+						(book_move(my_move, my_colour) == FAILURE && experience_move(my_move, my_colour) == FAILURE));
+			if (searched)
+				search_master(my_move, my_colour, DEPTH, time_limit, 0, fp);
+			gamerec_add(&record, my_colour, move_square(my_move));
+
+			TRACE_BEGIN(TRACE_COMMS_SEND, -1);
+			result = comms_send_move(my_move);
+			TRACE_END(TRACE_COMMS_SEND);
+
+			/*Collect the search statistics of every process, after the move has been answered*/
+			TRACE_BEGIN(TRACE_GATHER, -1);
+			if (searched)
+				stats_gather(fptr_stats, move_nr, my_colour, my_move);
+			TRACE_END(TRACE_GATHER);
+
+			TRACE_BEGIN(TRACE_LOG, -1);
+			LOG_BOARD(board, BOARDSIZE);
+			TRACE_END(TRACE_LOG);
+
+			if (result == FAILURE)
 			{
 				running = 0;
-				fprintf(fp, "Move send failed\n");
-				fflush(fp);
+				LOG_ERROR("Move send failed\n");
 				break;
 			}
 
@@ -196,214 +600,1699 @@ void run_master(int argc, char *argv[])
 		else if (strcmp(cmd, "play_move") == 0)
 		{
 			apply_opp_move(opponent_move, my_colour, fp);
-			print_board(fp);
+			gamerec_add(&record, opponent(my_colour, fp), move_square(opponent_move));
+			TRACE_BEGIN(TRACE_LOG, -1);
+			LOG_BOARD(board, BOARDSIZE);
+			TRACE_END(TRACE_LOG);
 
 			/* Received unknown message */
 		}
 		else
 		{
-			fprintf(fp, "Received unknown command from referee\n");
+			LOG_WARN("Received unknown command from referee\n");
+		}
+	}
+
+	stats_game_summary(fptr_stats, move_nr);
+	if (fptr_stats != NULL)
+		fclose(fptr_stats);
+	fptr_stats = NULL;
+	if (game_filename != NULL && gamerec_write(&record, game_filename) == FAILURE)
+		LOG_ERROR("File %s could not be written\n", game_filename);
+	free(game_filename);
+	game_filename = NULL;
+
+	save_experience();
+}
+
+/**
+ *   Rank 0 in stdio mode: reads one command per line from stdin and answers on stdout
+ *     position startpos [moves m1 m2 ...]        the initial position, black to move
+ *     position <n*n squares> <b|w> [moves ...]   squares row by row as . b w, then the side to move
+ *     go [depth n] [time seconds]               searches the position and answers
+ *                                                "info depth d score s nodes n time t" and "bestmove rc|pass";
+ *                                                with a time and no depth it deepens until the time is up
+ *     stop                                       ends a running go early
+ *     stats                                      the search statistics of the last go as a JSON line
+ *     board, isready, quit
+ *   Moves are written as in the referee protocol ("23" is row 2, column 3) or "pass".
+ *   Errors are answered with a line starting with "error".
+ */
+void run_text_master(int argc, char *argv[])
+{
+	char line[TEXT_LINESIZE];
+	char move[MOVEBUFSIZE];
+	char iteration_move[MOVEBUFSIZE];
+	char error[64];
+	char *token, *save;
+	char *last_stats = NULL;
+	size_t stats_size;
+	FILE *stats_fp;
+	FILE *fp = NULL;
+	int *saved_board = (int *)malloc(BOARDSIZE * sizeof(int));
+	int colour = BLACK;
+	int depth, score = 0, iteration_score, d, deepen;
+	long long nodes;
+	double limit, t;
+
+	if (argc >= 3)
+		fp = fopen(argv[2], "w");
+	log_init(fp, NULL, print_board); // logs to stderr without a file
+
+	while (text_get_line(line, sizeof(line)) == SUCCESS)
+	{
+		token = strtok_r(line, " \t", &save);
+		if (token == NULL)
+			continue;
+
+		if (strcmp(token, "quit") == 0)
+		{
+			break;
+		}
+		else if (strcmp(token, "isready") == 0)
+		{
+			text_send("readyok\n");
+		}
+		else if (strcmp(token, "board") == 0)
+		{
+			print_board(stdout, board);
+			text_send("%s to move\n", (colour == BLACK) ? "black" : "white");
+		}
+		else if (strcmp(token, "stop") == 0)
+		{
+			/* the search is over already */
+		}
+		else if (strcmp(token, "stats") == 0)
+		{
+			if (last_stats != NULL)
+				text_send("%s", last_stats);
+			else
+				text_send("error no search yet\n");
+		}
+		else if (strcmp(token, "position") == 0)
+		{
+			if (set_position(strtok_r(NULL, " \t", &save), &save, &colour, error, sizeof(error)) == FAILURE)
+				text_send("error %s\n", error);
+		}
+		else if (strcmp(token, "go") == 0)
+		{
+			depth = 0;
+			limit = 0;
+			while ((token = strtok_r(NULL, " \t", &save)) != NULL)
+			{
+				if (strcmp(token, "depth") == 0 && (token = strtok_r(NULL, " \t", &save)) != NULL)
+					depth = min(max(atoi(token), 1), STATS_MAX_PLY - 1);
+				else if (strcmp(token, "time") == 0 && (token = strtok_r(NULL, " \t", &save)) != NULL)
+					limit = atof(token); // as for gen_move, the search stops TIME_OFFSET before the limit
+			}
+
+			/* with a time and no depth alpha-beta deepens one ply at a time until the time is up, as
+			   analyse does for a node budget; the result is that of the deepest search not cut short */
+			deepen = (depth == 0 && limit > 0 && engine == ENGINE_ALPHABETA);
+			if (depth == 0)
+				depth = deepen ? 1 : DEPTH;
+			nodes = 0;
+			t = MPI_Wtime();
+			for (d = depth;; d++)
+			{
+				/* gen_move_master plays the move on the board, go leaves the position as it is */
+				memcpy(saved_board, board, BOARDSIZE * sizeof(int));
+				iteration_score = search_master(iteration_move, colour, d, deepen ? limit - (MPI_Wtime() - t) : limit, 1, fp);
+				memcpy(board, saved_board, BOARDSIZE * sizeof(int));
+
+				/* the record of the previous search is replaced, open_memstream allocates a new buffer */
+				free(last_stats);
+				last_stats = NULL;
+				stats_fp = open_memstream(&last_stats, &stats_size);
+				stats_gather(stats_fp, 0, colour, iteration_move);
+				fclose(stats_fp);
+				nodes += stats_total_nodes();
+
+				if (d == depth || !stop_search)
+				{
+					score = iteration_score;
+					strcpy(move, iteration_move);
+					depth = d;
+				}
+				if (!deepen || stop_search || d == STATS_MAX_PLY - 1 || MPI_Wtime() - t >= limit - TIME_OFFSET)
+					break;
+			}
+			t = MPI_Wtime() - t;
+
+			text_send("info depth %d score %d nodes %lld time %.3f\n", depth, score, nodes, t);
+			text_send("bestmove %.*s\n", (int)strcspn(move, "\n"), move);
+		}
+		else
+		{
+			text_send("error unknown command %s\n", token);
 		}
 	}
 
-	if (running == 0)
+	free(last_stats);
+	free(saved_board);
+	stop_workers();
+}
+
+/**
+ *   Sets the board to the position given by token and the remaining tokens of save:
+ *   "startpos" or "<n*n squares> <b|w>" (n is BOARD_N), optionally followed by "moves" and a list of moves.
+ *   colour becomes the side to move. Returns FAILURE with a message in error
+ *   if the position is invalid or a move is illegal; the board may be changed then.
+ */
+int set_position(char *token, char **save, int *colour, char *error, int size)
+{
+	int loc, i;
+
+	if (token != NULL && strcmp(token, "startpos") == 0)
 	{
-		fclose(fptr_debug0);
-		fclose(fptr_debug1);
-		fclose(fptr_debug2);
-		fclose(fptr_debug3);
+		free_board();
+		initialise_board();
+		*colour = BLACK;
+	}
+	else if (token != NULL && strlen(token) == BOARD_CELLS)
+	{
+		for (i = 0; i < BOARD_CELLS && strchr(".bw", token[i]) != NULL; i++)
+			board[BOARD_LOC(i / BOARD_N, i % BOARD_N)] = (char *)memchr(piecenames, token[i], 3) - piecenames;
+		bb_sync(board);
+		token = strtok_r(NULL, " \t", save);
+		if (i < BOARD_CELLS || token == NULL || (strcmp(token, "b") != 0 && strcmp(token, "w") != 0))
+		{
+			snprintf(error, size, "invalid position");
+			return FAILURE;
+		}
+		*colour = (token[0] == 'b') ? BLACK : WHITE;
+	}
+	else
+	{
+		snprintf(error, size, "invalid position");
+		return FAILURE;
 	}
 
-	//*Broadcast running to every process*/
-	MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	token = strtok_r(NULL, " \t", save);
+	if (token == NULL || strcmp(token, "moves") != 0)
+		return SUCCESS;
+	while ((token = strtok_r(NULL, " \t", save)) != NULL)
+	{
+		if (strcmp(token, "pass") != 0)
+		{
+			loc = (strlen(token) == 2) ? get_loc(token) : -1;
+			if (!legalp(loc, *colour, NULL))
+			{
+				snprintf(error, size, "illegal move %.8s", token);
+				return FAILURE;
+			}
+			make_move(loc, *colour, NULL);
+		}
+		*colour = opponent(*colour, NULL);
+	}
+	return SUCCESS;
 }
 
-int initialise_master(int argc, char *argv[], int *time_limit, int *my_colour, FILE **fp)
+/**
+ *   Opens the log file and connects to the referee for the first game,
+ *   argv is <ip> <port> <time_limit> <filename>. game_nr is 0 for a single game,
+ *   see connect_referee.
+ */
+int initialise_master(int argc, char *argv[], double *time_limit, int *my_colour, FILE **fp, int game_nr)
 {
 	int result = FAILURE;
 
 	if (argc == 5)
 	{
-		unsigned long ip = inet_addr(argv[1]);
-		int port = atoi(argv[2]);
-		*time_limit = atoi(argv[3]);
+		*time_limit = atof(argv[3]);
 
 		*fp = fopen(argv[4], "w");
+		log_init(*fp, NULL, print_board); // logs to stderr if the file could not be opened
 		if (*fp != NULL)
 		{
-			fprintf(*fp, "Initialise communication and get player colour \n");
-			if (comms_init_network(my_colour, ip, port) != FAILURE)
+			trace_filename = output_filename(argv[4], "_trace.json");
+			load_experience(); // before the clock of the first move runs
+			if (book_open(BOOK_FILE) == SUCCESS)
+				LOG_INFO("Opening book %s\n", BOOK_FILE);
+			result = connect_referee(argv, game_nr, my_colour);
+		}
+		else
+		{
+			LOG_ERROR("File %s could not be opened\n", argv[4]);
+		}
+	}
+	else
+	{
+		log_init(NULL, NULL, print_board);
+		LOG_ERROR("Arguments: [--daemon] <ip> <port> <time_limit> <filename> \n");
+	}
+
+	return result;
+}
+
+/**
+ *   Connects to the referee and opens the statistics and game record files of the game,
+ *   named after the log file argv[4]. In daemon mode (game_nr > 0) their names get the
+ *   game number, e.g. "black_3_stats.jsonl", the log file is shared by all games.
+ */
+int connect_referee(char *argv[], int game_nr, int *my_colour)
+{
+	char tag[16] = "";
+	char suffix[32];
+	char *filename;
+
+	LOG_INFO("Initialise communication and get player colour \n");
+	if (comms_init_network(my_colour, inet_addr(argv[1]), atoi(argv[2])) == FAILURE)
+		return FAILURE;
+
+	if (game_nr > 0)
+		snprintf(tag, sizeof(tag), "_%d", game_nr);
+	snprintf(suffix, sizeof(suffix), "%s_stats.jsonl", tag);
+	filename = output_filename(argv[4], suffix);
+	fptr_stats = fopen(filename, "w");
+	if (fptr_stats == NULL)
+		LOG_ERROR("File %s could not be opened\n", filename);
+	free(filename);
+	snprintf(suffix, sizeof(suffix), "%s_game.bin", tag);
+	game_filename = output_filename(argv[4], suffix);
+	return SUCCESS;
+}
+
+void initialise_board(void)
+{
+	int i, mid = BOARD_N / 2;
+	board = (int *)malloc(BOARDSIZE * sizeof(int));
+	for (i = 0; i < BOARD_SQUARES; i++)
+	{
+		if (validp(i))
+			board[i] = EMPTY;
+		else
+			board[i] = OUTER;
+	}
+	board[BOARD_LOC(mid - 1, mid - 1)] = WHITE;
+	board[BOARD_LOC(mid - 1, mid)] = BLACK;
+	board[BOARD_LOC(mid, mid - 1)] = BLACK;
+	board[BOARD_LOC(mid, mid)] = WHITE;
+	bb_sync(board);
+}
+
+void free_board(void)
+{
+	free(board);
+}
+
+/**
+ *   Derives the name of an additional output file from the log file given to the player,
+ *   e.g. ("black.txt", "_stats.jsonl") gives "black_stats.jsonl".
+ *   The caller frees the returned string.
+ */
+char *output_filename(const char *log_filename, const char *suffix)
+{
+	char *filename = (char *)malloc(strlen(log_filename) + strlen(suffix) + 1);
+	char *ext;
+
+	strcpy(filename, log_filename);
+	ext = strrchr(filename, '.');
+	if (ext != NULL && strchr(ext, '/') == NULL)
+		*ext = '\0';
+	strcat(filename, suffix);
+	return filename;
+}
+
+/**
+ *   Rank i (i != 0) executes this code
+ *   ----------------------------------
+ *   Called at the start of execution on all ranks except for rank 0.
+ *   - run_worker should play minimax from its move(s)
+ *   - results should be send to Rank 0 for final selection of a move
+ */
+void run_worker(int rank)
+{
+	LOG_DEBUG("Hello from Proc %d\n", rank);
+
+	int job[JOB_SIZE];
+	int my_colour;
+	FILE *fp = NULL;
+	int my_loc = -1;
+	int my_score = -10000000;
+	int max_score = INT_MIN;
+	int max_loc = -1;
+	int *legalmoves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
+	memset(legalmoves, 0, LEGALMOVSBUFSIZE);
+	int *best_scores = (int *)malloc(nr_of_procs * sizeof(int));
+	int *best_locs = (int *)malloc(nr_of_procs * sizeof(int));
+	int *prev_board = (int *)malloc(BOARDSIZE * sizeof(int));
+	int perf_prev;
+	double t;
+
+	/*broadcast the first search job*/
+	TRACE_BEGIN(TRACE_IDLE, -1);
+	MPI_Bcast(job, JOB_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+	TRACE_END(TRACE_IDLE);
+
+	while (job[JOB_KIND] != JOB_QUIT)
+	{
+		if (job[JOB_KIND] != JOB_SEARCH)
+		{
+			if (job[JOB_KIND] == JOB_ANALYSE)
+				analyse_worker();
+			else if (job[JOB_KIND] == JOB_LOAD)
+				broadcast_entries(NULL, 0);
+			else if (job[JOB_KIND] == JOB_SAVE)
+				save_experience();
+			MPI_Bcast(job, JOB_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+			continue;
+		}
+
+		stats_reset();
+
+		/*broadcast the board*/
+		TRACE_BEGIN(TRACE_BCAST, -1);
+		STATS_MPI(MPI_Bcast(board, BOARDSIZE, MPI_INT, 0, MPI_COMM_WORLD));
+		TRACE_END(TRACE_BCAST);
+
+		start_search(job);
+		my_colour = job[JOB_COLOUR];
+
+		if (engine != ENGINE_ALPHABETA)
+		{
+			mcts_move(my_colour, NULL);
+			end_search();
+			TRACE_BEGIN(TRACE_GATHER, -1);
+			stats_gather(NULL, 0, my_colour, NULL);
+			TRACE_END(TRACE_GATHER);
+
+			TRACE_BEGIN(TRACE_IDLE, -1);
+			MPI_Bcast(job, JOB_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+			TRACE_END(TRACE_IDLE);
+			continue;
+		}
+
+		/*generate a move*/
+		legal_moves(my_colour, legalmoves, fp);
+		sym_unique_moves(board, legalmoves); // as rank 0 does
+
+		if (legalmoves[0] > 0)
+		{
+			for (int i = 1; i <= legalmoves[0]; i++)
 			{
-				result = SUCCESS;
+				if ((i % nr_of_procs) == rank)
+				{
+					my_loc = legalmoves[i];
+
+					t = MPI_Wtime();
+					perf_prev = PERF_ENTER(PERF_SEARCH);
+					memcpy(prev_board, board, BOARDSIZE * sizeof(int));
+
+					make_move(my_loc, my_colour, fp);
+
+					TRACE_BEGIN(TRACE_MINIMAX, my_loc);
+					my_score = -negamax(opponent(my_colour, fp), search_depth, -SCORE_INF, SCORE_INF);
+					TRACE_END(TRACE_MINIMAX);
+					stats.search_time += MPI_Wtime() - t;
+
+					memcpy(board, prev_board, BOARDSIZE * sizeof(int));
+					PERF_LEAVE(perf_prev);
+
+					if (my_score > max_score)
+					{
+						max_score = my_score;
+						max_loc = my_loc;
+					}
+				}
+				TRACE_BEGIN(TRACE_BCAST, -1);
+				STATS_MPI(MPI_Bcast(board, BOARDSIZE, MPI_INT, 0, MPI_COMM_WORLD));
+				TRACE_END(TRACE_BCAST);
 			}
-			fflush(*fp);
 		}
 		else
 		{
-			fprintf(stderr, "File %s could not be opened", argv[4]);
+			max_score = -1;
+			max_loc = -1;
 		}
+		end_search();
+
+		TRACE_BEGIN(TRACE_GATHER, -1);
+		/*gather all options for best score at master process*/
+		STATS_MPI(MPI_Gather(&max_score, 1, MPI_INT, best_scores, 1, MPI_INT, 0, MPI_COMM_WORLD));
+		/*gather all locations for the best score options at master process*/
+		STATS_MPI(MPI_Gather(&max_loc, 1, MPI_INT, best_locs, 1, MPI_INT, 0, MPI_COMM_WORLD));
+		/*tell the master process whether the time ran out before all moves were searched*/
+		STATS_MPI(MPI_Reduce(&stop_search, NULL, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD));
+
+		/*send the search statistics of this process to the master process*/
+		stats_gather(NULL, 0, my_colour, NULL);
+		TRACE_END(TRACE_GATHER);
+
+		/////////////////////reinitialise variables that will be reused when the while loop continues, and the historic value should NOT be remembered*/
+		max_loc = -1;
+		max_score = INT_MIN;
+		/////////////////////
+
+		/*broadcast the next search job*/
+		TRACE_BEGIN(TRACE_IDLE, -1);
+		MPI_Bcast(job, JOB_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+		TRACE_END(TRACE_IDLE);
+	}
+
+	free(legalmoves);
+	free(best_scores);
+	free(best_locs);
+	free(prev_board);
+}
+
+/**
+ *   Rank 0: broadcasts a search of the current board for colour to every rank
+ *   and runs its own part of it. Returns the score of the best move, which is
+ *   written to move and played on the board (see gen_move_master).
+ *   limit is in seconds, 0 for none; stoppable lets a stop command on stdin end the search.
+ */
+int search_master(char *move, int colour, int depth, double limit, int stoppable, FILE *fp)
+{
+	int job[JOB_SIZE];
+
+	job[JOB_KIND] = JOB_SEARCH;
+	job[JOB_COLOUR] = colour;
+	job[JOB_DEPTH] = depth;
+	job[JOB_TIME_MS] = (int)(limit * 1000);
+	job[JOB_STOPPABLE] = stoppable;
+
+	stats_reset();
+
+	TRACE_BEGIN(TRACE_BCAST, -1);
+	//*Broadcast the search job to every process*/
+	STATS_MPI(MPI_Bcast(job, JOB_SIZE, MPI_INT, 0, MPI_COMM_WORLD));
+
+	//*Broadcast board to every process*/
+	STATS_MPI(MPI_Bcast(board, BOARDSIZE, MPI_INT, 0, MPI_COMM_WORLD));
+	TRACE_END(TRACE_BCAST);
+
+	start_search(job);
+	if (engine != ENGINE_ALPHABETA)
+		return mcts_master(move, colour, fp);
+	return gen_move_master(move, colour, fp);
+}
+
+/**
+ *   Rank 0: tells the workers that there are no more searches
+ */
+void stop_workers(void)
+{
+	int job[JOB_SIZE];
+
+	memset(job, 0, sizeof(job));
+	MPI_Bcast(job, JOB_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+}
+
+/**
+ *   Rank 0: maps the experience file and copies its entries into the
+ *   transposition tables of all ranks, so that what earlier games searched
+ *   deeply is known from the first move on
+ */
+void load_experience(void)
+{
+	struct tt_entry *entries;
+	int job[JOB_SIZE];
+	int n;
+
+	if (experience_open(EXPERIENCE_FILE) == FAILURE)
+	{
+		LOG_WARN("Experience file %s could not be used\n", EXPERIENCE_FILE);
+		return;
+	}
+	use_experience = 1;
+	n = experience_entries(&entries);
+	LOG_INFO("%d positions from the experience file\n", n);
+
+	memset(job, 0, sizeof(job));
+	job[JOB_KIND] = JOB_LOAD;
+	MPI_Bcast(job, JOB_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+	broadcast_entries(entries, n);
+	free(entries);
+}
+
+/**
+ *   Every rank: rank 0 broadcasts n entries, which every rank stores in its transposition table
+ */
+void broadcast_entries(struct tt_entry *entries, int n)
+{
+	int i;
+
+	MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if (my_rank != 0)
+		entries = (struct tt_entry *)malloc((n + 1) * sizeof(struct tt_entry));
+	MPI_Bcast(entries, n * sizeof(struct tt_entry), MPI_BYTE, 0, MPI_COMM_WORLD);
+	for (i = 0; i < n; i++)
+		tt_store(entries[i].key, entries[i].depth, entries[i].score, entries[i].flag, entries[i].move);
+	if (my_rank != 0)
+		free(entries);
+}
+
+/**
+ *   Every rank, after a game: gathers the transposition table entries at least
+ *   EXPERIENCE_MIN_DEPTH deep, the root results of rank 0 among them, at rank 0,
+ *   which adds them to the experience file. Rank 0 starts the job for the workers.
+ */
+void save_experience(void)
+{
+	struct tt_entry *entries, *all = NULL;
+	int job[JOB_SIZE];
+	int *counts = NULL, *displs = NULL;
+	int n, total = 0, r;
+
+	if (my_rank == 0 && !use_experience)
+		return;
+	if (my_rank == 0)
+	{
+		memset(job, 0, sizeof(job));
+		job[JOB_KIND] = JOB_SAVE;
+		MPI_Bcast(job, JOB_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+		counts = (int *)malloc(nr_of_procs * sizeof(int));
+		displs = (int *)malloc(nr_of_procs * sizeof(int));
+	}
+
+	n = tt_collect(EXPERIENCE_MIN_DEPTH, &entries) * sizeof(struct tt_entry);
+	MPI_Gather(&n, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if (my_rank == 0)
+	{
+		for (r = 0; r < nr_of_procs; r++)
+		{
+			displs[r] = total;
+			total += counts[r];
+		}
+		all = (struct tt_entry *)malloc(total + 1);
+	}
+	MPI_Gatherv(entries, n, MPI_BYTE, all, counts, displs, MPI_BYTE, 0, MPI_COMM_WORLD);
+
+	if (my_rank == 0)
+	{
+		if (experience_merge(all, total / sizeof(struct tt_entry)) == FAILURE)
+			LOG_WARN("Experience file %s not written\n", EXPERIENCE_FILE);
+		else
+			LOG_INFO("%d positions merged into the experience file\n", (int)(total / sizeof(struct tt_entry)));
+	}
+	free(entries);
+	free(all);
+	free(counts);
+	free(displs);
+}
+
+/**
+ *   Rank 0: plays the move an earlier game found for this position, when it was
+ *   searched at least as deep as a search would now. FAILURE if there is none.
+ */
+int experience_move(char *move, int colour)
+{
+	int sym;
+	uint64_t key = tt_hash(board, colour, &sym);
+	const struct tt_entry *saved = experience_probe(key);
+	struct tt_entry e;
+	int loc;
+
+	if (saved == NULL)
+		return FAILURE;
+	e = *saved; // the file may change under us, the copy is checked
+	loc = sym_loc_inverse(e.move, sym);
+	if (e.key != key || e.flag != TT_EXACT || e.depth < DEPTH + 1 || !legalp(loc, colour, NULL))
+		return FAILURE;
+	get_move_string(loc, move);
+	make_move(loc, colour, NULL);
+	LOG_INFO("Move %c%c from the experience file, score %d depth %d\n", move[0], move[1], e.score, e.depth);
+	return SUCCESS;
+}
+
+/**
+ *   Rank 0: plays the best move of the opening book for this position, without
+ *   searching. FAILURE if the position is not in the book.
+ */
+int book_move(char *move, int colour)
+{
+	struct book_entry e;
+	int sym, loc;
+
+	if (book_probe(tt_hash(board, colour, &sym), &e) == FAILURE)
+		return FAILURE;
+	loc = sym_loc_inverse(e.move, sym);
+	if (!legalp(loc, colour, NULL))
+		return FAILURE;
+	get_move_string(loc, move);
+	make_move(loc, colour, NULL);
+	LOG_INFO("Move %c%c from the book, score %d count %u\n", move[0], move[1], e.score, e.count);
+	return SUCCESS;
+}
+
+/**
+ *   Every rank: sets up the search described by job, the clock of the time limit
+ *   starts here and runs over all root moves of the rank
+ */
+void start_search(const int *job)
+{
+	search_depth = job[JOB_DEPTH];
+	search_time_limit = job[JOB_TIME_MS] / 1000.0;
+	search_stoppable = job[JOB_STOPPABLE];
+	search_node_limit = ((engine == ENGINE_MCTS || engine == ENGINE_MCTS_EVAL) && search_time_limit == 0)
+							? (long long)search_depth * MCTS_PLAYOUTS_PER_PLY
+							: 0;
+	stop_search = 0;
+	start_time = MPI_Wtime();
+}
+
+/**
+ *   Called at every node: returns 1 when the time is up or the search was stopped.
+ *   In a stoppable search rank 0 checks stdin for a stop command every STOP_CHECK_NODES
+ *   nodes and passes it on to the workers, which check for it as often.
+ */
+int search_stopped(void)
+{
+	int flag = 0;
+	int r;
+
+	if (stop_search)
+		return 1;
+	if (search_time_limit > 0 && MPI_Wtime() - start_time >= search_time_limit - TIME_OFFSET)
+		return stop_search = 1;
+	if (search_node_limit > 0 && stats.nodes >= search_node_limit)
+		return stop_search = 1;
+	if (!search_stoppable || stats.nodes % STOP_CHECK_NODES != 0)
+		return 0;
+
+	if (my_rank == 0 && text_poll_stop())
+	{
+		stop_search = 1;
+		for (r = 1; r < nr_of_procs; r++)
+			MPI_Send(&stop_search, 1, MPI_INT, r, TAG_STOP, MPI_COMM_WORLD);
+	}
+	else if (my_rank != 0)
+	{
+		MPI_Iprobe(0, TAG_STOP, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+		if (flag)
+		{
+			MPI_Recv(&r, 1, MPI_INT, 0, TAG_STOP, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			stop_search = 1;
+		}
+	}
+	return stop_search;
+}
+
+/**
+ *   Every rank, after its part of a stoppable search: rank 0 keeps watching stdin
+ *   until every rank is done, then sends TAG_DONE so that the workers can consume
+ *   any stop message still on its way before the next search
+ */
+void end_search(void)
+{
+	MPI_Request request;
+	MPI_Status status;
+	struct timespec idle = {0, 1000000};
+	int done = 0;
+	int r;
+
+	if (!search_stoppable || nr_of_procs == 1)
+		return;
+
+	MPI_Ibarrier(MPI_COMM_WORLD, &request);
+	if (my_rank == 0)
+	{
+		while (!done)
+		{
+			MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+			if (!done && !stop_search && text_poll_stop())
+			{
+				stop_search = 1;
+				for (r = 1; r < nr_of_procs; r++)
+					MPI_Send(&stop_search, 1, MPI_INT, r, TAG_STOP, MPI_COMM_WORLD);
+			}
+			else if (!done)
+			{
+				nanosleep(&idle, NULL);
+			}
+		}
+		for (r = 1; r < nr_of_procs; r++)
+			MPI_Send(&r, 1, MPI_INT, r, TAG_DONE, MPI_COMM_WORLD);
+	}
+	else
+	{
+		MPI_Wait(&request, MPI_STATUS_IGNORE);
+		do
+		{
+			MPI_Recv(&r, 1, MPI_INT, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+		} while (status.MPI_TAG != TAG_DONE);
+	}
+}
+
+/**
+ *   Rank 0 in analysis mode: "my_player --analyse [depth n] [nodes n] [file]" reads one
+ *   position per line from file (stdin without one), written as after the position command
+ *   of the stdio mode, and writes one line per position to stdout:
+ *     <line number> bestmove <rc|pass> score <s> depth <d> nodes <n> pv <moves>
+ *   or "<line number> error <message>". Empty lines and lines starting with # are skipped.
+ */
+void run_analysis(int argc, char *argv[])
+{
+	struct analysis_queue queue;
+	int line_nr = 0;
+	int depth = 0;
+	long long nodes = 0;
+	int colour, i;
+	char line[TEXT_LINESIZE];
+	char label[16];
+	char error[64];
+	char *token, *save;
+	FILE *in = stdin;
+
+	log_init(NULL, NULL, print_board); // logs to stderr
+
+	for (i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "depth") == 0 && i + 1 < argc)
+			depth = min(max(atoi(argv[++i]), 1), STATS_MAX_PLY - 1);
+		else if (strcmp(argv[i], "nodes") == 0 && i + 1 < argc)
+			nodes = node_budget(argv[++i]);
+		else if ((in = fopen(argv[i], "r")) == NULL)
+			LOG_ERROR("File %s could not be opened\n", argv[i]);
+	}
+	/* with only a node budget, iterative deepening goes as deep as the budget allows */
+	if (depth == 0)
+		depth = (nodes > 0) ? STATS_MAX_PLY - 1 : DEPTH;
+
+	queue_init(&queue, depth, nodes, 0);
+	while (in != NULL && fgets(line, sizeof(line), in) != NULL)
+	{
+		line_nr++;
+		line[strcspn(line, "\r\n")] = '\0';
+		token = strtok_r(line, " \t", &save);
+		if (token == NULL || token[0] == '#')
+			continue;
+
+		snprintf(label, sizeof(label), "%d", line_nr);
+		if (set_position(token, &save, &colour, error, sizeof(error)) == FAILURE)
+			queue_add_line(&queue, label, error);
+		else
+			queue_add(&queue, label, colour, -1);
+	}
+	queue_finish(&queue);
+
+	if (in != NULL && in != stdin)
+		fclose(in);
+	stop_workers();
+}
+
+/**
+ *   Rank 0 in blunder mode: "my_player --blunders [depth n] [nodes n] [threshold n] files..."
+ *   replays the game records (<log>_game.bin) and searches the position before every move
+ *   of the player that wrote the record, deeper than during the game. A move is reported if
+ *   its score is at least threshold below that of the best move:
+ *     <file> <move number> played <rc> score <s> bestmove <rc> score <s> loss <l> depth <d> pv <moves>
+ *   followed by a summary line starting with #.
+ */
+void run_blunders(int argc, char *argv[])
+{
+	struct analysis_queue queue;
+	struct game_record record;
+	int depth = DEPTH + 2;
+	long long nodes = 0;
+	int threshold = 50;
+	int nr_games = 0;
+	int colour, square, loc, i, m;
+	char label[TEXT_LINESIZE];
+	char error[64];
+
+	log_init(NULL, NULL, print_board); // logs to stderr
+
+	for (i = 2; i < argc && i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "depth") == 0)
+			depth = min(max(atoi(argv[i + 1]), 1), STATS_MAX_PLY - 1);
+		else if (strcmp(argv[i], "nodes") == 0)
+			nodes = node_budget(argv[i + 1]);
+		else if (strcmp(argv[i], "threshold") == 0)
+			threshold = max(atoi(argv[i + 1]), 0);
+		else
+			break;
+	}
+
+	queue_init(&queue, depth, nodes, threshold);
+	for (; i < argc; i++)
+	{
+		if (gamerec_read(&record, argv[i]) == FAILURE || record.size != BOARD_N)
+		{
+			snprintf(error, sizeof(error), "not a %dx%d game record", BOARD_N, BOARD_N);
+			queue_add_line(&queue, argv[i], error);
+			continue;
+		}
+		nr_games++;
+
+		free_board();
+		initialise_board();
+		for (m = 0; m < record.nr_moves; m++)
+		{
+			colour = record.colours[m];
+			square = record.squares[m];
+			if (square == GAMEREC_PASS)
+				continue;
+			loc = BOARD_LOC(square / BOARD_N, square % BOARD_N);
+			if ((colour != BLACK && colour != WHITE) || !legalp(loc, colour, NULL))
+			{
+				snprintf(error, sizeof(error), "illegal move %d", m + 1);
+				queue_add_line(&queue, argv[i], error);
+				break;
+			}
+			if (colour == record.my_colour)
+			{
+				snprintf(label, sizeof(label), "%s %d", argv[i], m + 1);
+				queue_add(&queue, label, colour, loc);
+			}
+			make_move(loc, colour, NULL);
+		}
+	}
+	queue_finish(&queue);
+
+	text_send("# %d games, %d moves searched to depth %d, %d lose %d or more\n",
+			  nr_games, queue.nr_checked, depth, queue.nr_blunders, threshold);
+	stop_workers();
+}
+
+/**
+ *   Rank 0 in book mode: "my_player --book [plies n] [depth n] [nodes n] [checkpoint file] [output file]"
+ *   expands every line of play from the initial position to plies moves (default 6), analyses the
+ *   positions at the end of the lines on all ranks to depth (default DEPTH + 2), backs their scores up
+ *   the tree with negamax and writes the opening book (book.h, default BOOK_FILE). The analyses are
+ *   appended to the checkpoint (default book.ckpt, book6.ckpt for BOARD_N 6), one line per position as in the analysis mode with
+ *   the key of the position as label; an interrupted build started again only analyses the rest.
+ */
+void run_book(int argc, char *argv[])
+{
+	struct analysis_queue queue;
+	struct node_map map;
+	struct book_entry *entries = NULL;
+	const char *checkpoint = "book" BOARD_SUFFIX ".ckpt";
+	const char *output = BOOK_FILE;
+	int plies = 6;
+	int depth = DEPTH + 2;
+	long long nodes = 0;
+	int n = 0, capacity = 0;
+	int resumed, i;
+
+	log_init(NULL, NULL, print_board); // logs to stderr
+
+	for (i = 2; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "plies") == 0)
+			plies = min(max(atoi(argv[i + 1]), 1), 60);
+		else if (strcmp(argv[i], "depth") == 0)
+			depth = min(max(atoi(argv[i + 1]), 1), STATS_MAX_PLY - 1);
+		else if (strcmp(argv[i], "nodes") == 0)
+			nodes = node_budget(argv[i + 1]);
+		else if (strcmp(argv[i], "checkpoint") == 0)
+			checkpoint = argv[i + 1];
+		else if (strcmp(argv[i], "output") == 0)
+			output = argv[i + 1];
+	}
+
+	map.capacity = 1 << 16;
+	map.size = 0;
+	map.nodes = (struct book_node *)calloc(map.capacity, sizeof(struct book_node));
+	resumed = read_checkpoint(&map, checkpoint);
+
+	queue_init(&queue, depth, nodes, 0);
+	queue.out = open_checkpoint(checkpoint);
+	free_board();
+	initialise_board();
+	expand_book(&map, &queue, BLACK, 0, plies);
+	LOG_INFO("%d positions to analyse, %d of them from %s\n", queue.nr_added + resumed, resumed, checkpoint);
+	(void)resumed; // only logged, unused when LOG_INFO compiles to nothing
+	queue_finish(&queue);
+	if (queue.out != stdout)
+		fclose(queue.out);
+
+	/* all leaves are in the checkpoint now */
+	read_checkpoint(&map, checkpoint);
+	free_board();
+	initialise_board();
+	back_up(&map, BLACK, 0, plies, &entries, &n, &capacity);
+	if (book_write(output, entries, n) == FAILURE)
+		LOG_ERROR("File %s could not be written\n", output);
+	else
+		text_send("# book of %d moves, %d plies deep, depth %d, written to %s\n", n, plies, depth, output);
+
+	free(entries);
+	free(map.nodes);
+	stop_workers();
+}
+
+/**
+ *   Rank 0 in solve mode: "my_player --solve [plies n] [checkpoint file]" solves the game from the
+ *   initial position. The positions plies moves deep (default 8) are solved exactly on all ranks
+ *   (solve_position) and their scores are backed up the tree with negamax, as the book builder does
+ *   with its analyses. The solved positions are appended to the checkpoint (default solve.ckpt,
+ *   solve6.ckpt for BOARD_N 6), so an interrupted run started again only solves the rest.
+ *   The 6x6 result is checked against the known one, a 16-20 win for white.
+ */
+void run_solve(int argc, char *argv[])
+{
+	struct analysis_queue queue;
+	struct node_map map;
+	const char *checkpoint = "solve" BOARD_SUFFIX ".ckpt";
+	double start = MPI_Wtime();
+	int plies = 8;
+	int resumed, score, i;
+
+	log_init(NULL, NULL, print_board); // logs to stderr
+
+	for (i = 2; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "plies") == 0)
+			plies = min(max(atoi(argv[i + 1]), 0), BOARD_CELLS);
+		else if (strcmp(argv[i], "checkpoint") == 0)
+			checkpoint = argv[i + 1];
+	}
+
+	map.capacity = 1 << 16;
+	map.size = 0;
+	map.nodes = (struct book_node *)calloc(map.capacity, sizeof(struct book_node));
+	resumed = read_checkpoint(&map, checkpoint);
+
+	queue_init(&queue, 0, 0, 0); // depth 0 solves
+	queue.out = open_checkpoint(checkpoint);
+	free_board();
+	initialise_board();
+	expand_book(&map, &queue, BLACK, 0, plies);
+	LOG_INFO("%d positions to solve, %d of them from %s\n", queue.nr_added + resumed, resumed, checkpoint);
+	(void)resumed; // only logged, unused when LOG_INFO compiles to nothing
+	queue_finish(&queue);
+	if (queue.out != stdout)
+		fclose(queue.out);
+
+	read_checkpoint(&map, checkpoint);
+	free_board();
+	initialise_board();
+	score = back_up(&map, BLACK, 0, plies, NULL, NULL, NULL);
+	text_send("# solved from %d positions %d plies deep in %.1f s: black %d white %d\n", map.size, plies,
+			  MPI_Wtime() - start, (BOARD_CELLS + score) / 2, (BOARD_CELLS - score) / 2);
+#if BOARD_N == 6
+	text_send("# %s the known result, black 16 white 20\n", (score == -4) ? "matches" : "DIFFERS FROM");
+#endif
+
+	free(map.nodes);
+	stop_workers();
+}
+
+/**
+ *   Rank 0 in perft mode: "my_player --perft [depth n]" counts the leaves of the game tree from the
+ *   initial position up to depth n (default 9) with every move generation kernel (bitboard.h),
+ *   to check them against each other and to compare their speed. A pass is a move, a game
+ *   over before depth n is one leaf.
+ */
+void run_perft(int argc, char *argv[])
+{
+	int depth_limit = 9;
+	long long nodes, scalar_nodes = 0;
+	double start, seconds;
+	int depth, k, i;
+
+	log_init(NULL, NULL, print_board); // logs to stderr
+
+	for (i = 2; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "depth") == 0)
+			depth_limit = min(max(atoi(argv[i + 1]), 1), BOARD_CELLS);
+	}
+
+	for (depth = 1; depth <= depth_limit; depth++)
+	{
+		for (k = 0; k < BB_NR_KERNELS; k++)
+		{
+			if (!bb_use(k))
+				continue; // not on this cpu
+			start = MPI_Wtime();
+			nodes = perft(BLACK, depth, 0);
+			seconds = MPI_Wtime() - start;
+			text_send("# perft depth %d kernel %s nodes %lld time %.3f s %.1f Mnps\n", depth, bb_kernel_names[k], nodes,
+					  seconds, (seconds > 0) ? nodes / seconds / 1e6 : 0.0);
+			if (k == BB_SCALAR)
+				scalar_nodes = nodes;
+			else if (nodes != scalar_nodes)
+				LOG_ERROR("perft depth %d: kernel %s counts %lld nodes, scalar %lld\n", depth, bb_kernel_names[k], nodes, scalar_nodes);
+		}
+	}
+	bb_init();
+	stop_workers();
+}
+
+/**
+ *   Rank 0 in playout mode: "my_player --playouts [games n]" plays n random games (default 100000)
+ *   from the initial position, one board at a time with legal_moves and make_move, and then as a
+ *   batch (playout.h) with every kernel of the cpu, and compares their speed.
+ */
+void run_playouts(int argc, char *argv[])
+{
+	struct playout_batch batch;
+	int moves[LEGALMOVSBUFSIZE];
+	int start_board[BOARD_INTS];
+	int games = 100000;
+	int colour, passes, wins, g, k, i;
+	double start, seconds;
+
+	log_init(NULL, NULL, print_board); // logs to stderr
+
+	for (i = 2; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "games") == 0)
+			games = max(atoi(argv[i + 1]), 1);
+	}
+	memcpy(start_board, board, BOARDSIZE * sizeof(int));
+
+	srand(1);
+	wins = 0;
+	start = MPI_Wtime();
+	for (g = 0; g < games; g++)
+	{
+		memcpy(board, start_board, BOARDSIZE * sizeof(int));
+		colour = BLACK;
+		passes = 0;
+		while (passes < 2)
+		{
+			legal_moves(colour, moves, NULL);
+			passes = (moves[0] == 0) ? passes + 1 : 0;
+			if (moves[0] > 0)
+				make_move(moves[1 + rand() % moves[0]], colour, NULL);
+			colour = opponent(colour, NULL);
+		}
+		wins += (count(BLACK, board) > count(WHITE, board));
+	}
+	seconds = MPI_Wtime() - start;
+	text_send("# playouts single board games %d time %.3f s %.0f games/s black wins %.1f%%\n", games, seconds,
+			  games / seconds, 100.0 * wins / games);
+	memcpy(board, start_board, BOARDSIZE * sizeof(int));
+
+	for (k = 0; k < PLAYOUT_NR_KERNELS; k++)
+	{
+		if (!playout_use(k))
+			continue; // not on this cpu
+		if (playout_batch_init(&batch, games, 1) == 0)
+		{
+			LOG_ERROR("no memory for %d playouts\n", games);
+			break;
+		}
+		wins = 0;
+		start = MPI_Wtime();
+		for (g = 0; g < batch.size; g++)
+			playout_load(&batch, g, board, BLACK);
+		playout_run(&batch);
+		for (g = 0; g < batch.size; g++)
+			wins += (playout_score(&batch, g, BLACK) > 0);
+		seconds = MPI_Wtime() - start;
+		text_send("# playouts batch kernel %s games %d time %.3f s %.0f games/s black wins %.1f%%\n",
+				  playout_kernel_names[k], batch.size, seconds, batch.size / seconds, 100.0 * wins / batch.size);
+		playout_batch_free(&batch);
+	}
+	playout_init();
+	stop_workers();
+}
+
+/**
+ *   The number of leaves depth moves below the board, colour to move; passed is 1 when the
+ *   opponent passed to reach it. The last ply is counted without making its moves.
+ */
+long long perft(int colour, int depth, int passed)
+{
+	int moves[LEGALMOVSBUFSIZE];
+	int saved[BOARD_INTS];
+	long long n = 0;
+	int i;
+
+	if (depth == 0)
+		return 1;
+	legal_moves(colour, moves, NULL);
+	if (moves[0] == 0)
+		return passed ? 1 : perft(opponent(colour, NULL), depth - 1, 1);
+	if (depth == 1)
+		return moves[0];
+	memcpy(saved, board, BOARDSIZE * sizeof(int));
+	for (i = 1; i <= moves[0]; i++)
+	{
+		make_move(moves[i], colour, NULL);
+		n += perft(opponent(colour, NULL), depth - 1, 0);
+		memcpy(board, saved, BOARDSIZE * sizeof(int));
+	}
+	return n;
+}
+
+/**
+ *   Rank 0: opens the checkpoint of the book builder or the solver for appending,
+ *   stdout if it cannot be opened
+ */
+FILE *open_checkpoint(const char *filename)
+{
+	FILE *fp = fopen(filename, "a+");
+
+	if (fp == NULL)
+	{
+		LOG_ERROR("File %s could not be opened\n", filename);
+		return stdout;
+	}
+	if (fseek(fp, -1, SEEK_END) == 0 && fgetc(fp) != '\n')
+		fputc('\n', fp); // ends a line cut short by the interruption
+	return fp;
+}
+
+/**
+ *   Rank 0: marks the positions analysed in the checkpoint file as scored leaves.
+ *   Lines cut short by an interruption are skipped. Returns the number of positions.
+ */
+int read_checkpoint(struct node_map *map, const char *filename)
+{
+	char line[TEXT_LINESIZE];
+	unsigned long long key;
+	struct book_node *node;
+	int score, n = 0;
+	FILE *fp = fopen(filename, "r");
+
+	if (fp == NULL)
+		return 0;
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (strchr(line, '\n') == NULL || sscanf(line, "%llx bestmove %*s score %d", &key, &score) != 2)
+			continue;
+		node = find_node(map, key);
+		if (!node->scored)
+			n++;
+		node->scored = 1;
+		node->score = score;
+		node->leaves = 1;
+	}
+	fclose(fp);
+	return n;
+}
+
+/**
+ *   Rank 0: walks the lines of play from the board, colour to move at ply, and queues every
+ *   position at plies, or where the game is over, for analysis unless it was analysed before.
+ *   Positions reached by more than one line are visited once.
+ */
+void expand_book(struct node_map *map, struct analysis_queue *queue, int colour, int ply, int plies)
+{
+	int sym;
+	uint64_t key = tt_hash(board, colour, &sym);
+	struct book_node *node = find_node(map, key);
+	int *moves, *prev_board;
+	char label[32];
+	int i;
+
+	if (node->expanded)
+		return;
+	node->expanded = 1;
+
+	moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
+	legal_moves(colour, moves, NULL);
+	if (ply == plies || (moves[0] == 0 && !any_move(opponent(colour, NULL))))
+	{
+		if (!node->scored)
+		{
+			snprintf(label, sizeof(label), "%016llx", (unsigned long long)key);
+			queue_add(queue, label, colour, -1);
+		}
+	}
+	else if (moves[0] == 0)
+	{
+		expand_book(map, queue, opponent(colour, NULL), ply + 1, plies); // pass
+	}
+	else
+	{
+		prev_board = (int *)malloc(BOARDSIZE * sizeof(int));
+		for (i = 1; i <= moves[0]; i++)
+		{
+			memcpy(prev_board, board, BOARDSIZE * sizeof(int));
+			make_move(moves[i], colour, NULL);
+			expand_book(map, queue, opponent(colour, NULL), ply + 1, plies);
+			memcpy(board, prev_board, BOARDSIZE * sizeof(int));
+		}
+		free(prev_board);
+	}
+	free(moves);
+}
+
+/**
+ *   Rank 0: the negamax score of the board, colour to move at ply, from the scores of the
+ *   analysed leaves below it. Adds a book entry for every move of every inner position,
+ *   once per position, with the score of the move and the number of leaves below it,
+ *   unless entries is NULL.
+ */
+int back_up(struct node_map *map, int colour, int ply, int plies, struct book_entry **entries, int *n, int *capacity)
+{
+	int sym, child_sym;
+	uint64_t key = tt_hash(board, colour, &sym);
+	struct book_node *node = find_node(map, key);
+	int *moves, *prev_board;
+	int best = INT_MIN, leaves = 0, score, count, i;
+
+	if (node->backed_up || ply == plies)
+		return node->score; // a leaf missing from the checkpoint counts as 0
+
+	moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
+	legal_moves(colour, moves, NULL);
+	sym_unique_moves(board, moves); // the others have the same entry in the turned position
+	if (moves[0] == 0 && !any_move(opponent(colour, NULL)))
+	{
+		best = node->score; // game over, analysed as a leaf
+		leaves = 1;
+	}
+	else if (moves[0] == 0)
+	{
+		best = -back_up(map, opponent(colour, NULL), ply + 1, plies, entries, n, capacity);
+		leaves = find_node(map, tt_hash(board, opponent(colour, NULL), &child_sym))->leaves;
+	}
+	else
+	{
+		prev_board = (int *)malloc(BOARDSIZE * sizeof(int));
+		for (i = 1; i <= moves[0]; i++)
+		{
+			memcpy(prev_board, board, BOARDSIZE * sizeof(int));
+			make_move(moves[i], colour, NULL);
+			score = -back_up(map, opponent(colour, NULL), ply + 1, plies, entries, n, capacity);
+			count = find_node(map, tt_hash(board, opponent(colour, NULL), &child_sym))->leaves;
+			leaves += count;
+			if (entries != NULL)
+			{
+				if (*n == *capacity)
+				{
+					*capacity = (*capacity == 0) ? 1024 : 2 * *capacity;
+					*entries = (struct book_entry *)realloc(*entries, *capacity * sizeof(struct book_entry));
+				}
+				(*entries)[*n].key = key;
+				(*entries)[*n].move = sym_loc(moves[i], sym);
+				(*entries)[*n].score = max(min(score, INT16_MAX), INT16_MIN);
+				(*entries)[*n].count = count;
+				(*n)++;
+			}
+			best = max(best, score);
+			memcpy(board, prev_board, BOARDSIZE * sizeof(int));
+		}
+		free(prev_board);
+	}
+	free(moves);
+
+	/* the table may have grown, which moves the nodes */
+	node = find_node(map, key);
+	node->scored = 1;
+	node->backed_up = 1;
+	node->score = best;
+	node->leaves = leaves;
+	return best;
+}
+
+/**
+ *   Rank 0: the node of the position with this key, a new one if it is not in the map yet
+ */
+struct book_node *find_node(struct node_map *map, uint64_t key)
+{
+	struct book_node *old;
+	int i, capacity;
+
+	if (key == 0)
+		key = 1; // 0 marks a free slot
+	if (2 * (map->size + 1) > map->capacity)
+	{
+		old = map->nodes;
+		capacity = map->capacity;
+		map->capacity *= 2;
+		map->size = 0;
+		map->nodes = (struct book_node *)calloc(map->capacity, sizeof(struct book_node));
+		for (i = 0; i < capacity; i++)
+		{
+			if (old[i].key != 0)
+				*find_node(map, old[i].key) = old[i];
+		}
+		free(old);
+	}
+	for (i = key & (map->capacity - 1); map->nodes[i].key != 0; i = (i + 1) & (map->capacity - 1))
+	{
+		if (map->nodes[i].key == key)
+			return &map->nodes[i];
+	}
+	map->nodes[i].key = key;
+	map->size++;
+	return &map->nodes[i];
+}
+
+/**
+ *   The node budget of an analysis given on the command line, 0 (none) unless it is positive
+ */
+long long node_budget(const char *arg)
+{
+	long long nodes = atoll(arg);
+
+	return (nodes > 0) ? nodes : 0;
+}
+
+/**
+ *   Rank 0: starts an analysis on every rank. The positions added to the queue are
+ *   handed out one at a time to whichever worker is free (with a single rank rank 0
+ *   analyses them itself), and a result is held back until those of all earlier
+ *   positions are written.
+ */
+void queue_init(struct analysis_queue *queue, int depth, long long nodes, int threshold)
+{
+	int job[JOB_SIZE];
+
+	memset(queue, 0, sizeof(*queue));
+	queue->busy = (int *)calloc(nr_of_procs, sizeof(int));
+	queue->msg = (int *)malloc((ANALYSE_SIZE + BOARDSIZE) * sizeof(int));
+	queue->depth = depth;
+	queue->nodes = nodes;
+	queue->threshold = threshold;
+	queue->out = stdout;
+
+	memset(job, 0, sizeof(job));
+	job[JOB_KIND] = JOB_ANALYSE;
+	MPI_Bcast(job, JOB_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+}
+
+/* Appends a position to the queue, its output is still missing */
+struct analysis *queue_append(struct analysis_queue *queue, const char *label, int played)
+{
+	struct analysis *a;
+
+	if (queue->nr_added == queue->capacity)
+	{
+		queue->capacity = (queue->capacity == 0) ? 64 : 2 * queue->capacity;
+		queue->positions = (struct analysis *)realloc(queue->positions, queue->capacity * sizeof(struct analysis));
+	}
+	a = &queue->positions[queue->nr_added++];
+	a->label = strdup(label);
+	a->played = played;
+	a->output = NULL;
+	return a;
+}
+
+/**
+ *   Rank 0: analyses the board for colour; played is the move made in the game, -1 if none
+ */
+void queue_add(struct analysis_queue *queue, const char *label, int colour, int played)
+{
+	long long result[RESULT_SIZE + STATS_MAX_PLY];
+	int index = queue->nr_added;
+	int r;
+
+	queue_append(queue, label, played);
+	if (played != -1)
+		queue->nr_checked++;
+
+	if (nr_of_procs == 1)
+	{
+		analyse(colour, queue->depth, queue->nodes, played, result);
+		result[RESULT_INDEX] = index;
+		queue->positions[index].output = format_analysis(queue, &queue->positions[index], result);
+	}
+	else
+	{
+		/* wait for a worker to become free */
+		if (queue->in_flight == nr_of_procs - 1)
+			collect_analysis(queue);
+		for (r = 1; queue->busy[r]; r++)
+			;
+		queue->msg[ANALYSE_INDEX] = index;
+		queue->msg[ANALYSE_COLOUR] = colour;
+		queue->msg[ANALYSE_DEPTH] = queue->depth;
+		queue->msg[ANALYSE_NODES_HIGH] = (int)(queue->nodes >> 31);
+		queue->msg[ANALYSE_NODES_LOW] = (int)(queue->nodes & INT_MAX);
+		queue->msg[ANALYSE_PLAYED] = played;
+		memcpy(queue->msg + ANALYSE_SIZE, board, BOARDSIZE * sizeof(int));
+		MPI_Send(queue->msg, ANALYSE_SIZE + BOARDSIZE, MPI_INT, r, TAG_ANALYSE, MPI_COMM_WORLD);
+		queue->busy[r] = 1;
+		queue->in_flight++;
+	}
+	write_analysis(queue);
+}
+
+/**
+ *   Rank 0: adds an error line in place of a result, "<label> error <message>"
+ */
+void queue_add_line(struct analysis_queue *queue, const char *label, const char *error)
+{
+	struct analysis *a = queue_append(queue, label, -1);
+	char buf[TEXT_LINESIZE];
+
+	snprintf(buf, sizeof(buf), "%s error %s\n", label, error);
+	a->output = strdup(buf);
+	write_analysis(queue);
+}
+
+/**
+ *   Rank 0: waits for the outstanding results, writes them and ends the analysis on the workers
+ */
+void queue_finish(struct analysis_queue *queue)
+{
+	int r;
+
+	while (queue->in_flight > 0)
+	{
+		collect_analysis(queue);
+		write_analysis(queue);
+	}
+
+	/* no more positions */
+	queue->msg[ANALYSE_INDEX] = -1;
+	for (r = 1; r < nr_of_procs; r++)
+		MPI_Send(queue->msg, ANALYSE_SIZE + BOARDSIZE, MPI_INT, r, TAG_ANALYSE, MPI_COMM_WORLD);
+
+	free(queue->positions);
+	free(queue->busy);
+	free(queue->msg);
+	queue->positions = NULL;
+	queue->busy = NULL;
+	queue->msg = NULL;
+}
+
+/**
+ *   Rank 0: receives the result of whichever worker finishes first and frees that worker
+ */
+void collect_analysis(struct analysis_queue *queue)
+{
+	long long result[RESULT_SIZE + STATS_MAX_PLY];
+	struct analysis *a;
+	MPI_Status status;
+
+	MPI_Recv(result, RESULT_SIZE + STATS_MAX_PLY, MPI_LONG_LONG, MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &status);
+	queue->busy[status.MPI_SOURCE] = 0;
+	queue->in_flight--;
+	a = &queue->positions[result[RESULT_INDEX]];
+	a->output = format_analysis(queue, a, result);
+}
+
+/**
+ *   Rank 0: writes the results that are complete, up to the first one still missing
+ */
+void write_analysis(struct analysis_queue *queue)
+{
+	struct analysis *a;
+
+	for (; queue->nr_written < queue->nr_added; queue->nr_written++)
+	{
+		a = &queue->positions[queue->nr_written];
+		if (a->output == NULL)
+			break;
+		fputs(a->output, queue->out);
+		free(a->output);
+		free(a->label);
+	}
+	fflush(queue->out);
+}
+
+/**
+ *   Formats a result as an output line of the analysis or the blunder mode, the caller frees it.
+ *   In the blunder mode the line is empty unless the played move is a blunder.
+ */
+char *format_analysis(struct analysis_queue *queue, const struct analysis *a, const long long *result)
+{
+	char buf[TEXT_LINESIZE];
+	char best[MOVEBUFSIZE];
+	char move[MOVEBUFSIZE];
+	long long loss = result[RESULT_SCORE] - result[RESULT_PLAYED_SCORE];
+	int len, i;
+
+	if (result[RESULT_MOVE] == -1)
+		strcpy(best, "pass");
+	else
+		get_move_string(result[RESULT_MOVE], best);
+	best[strcspn(best, "\n")] = '\0';
+
+	if (a->played == -1)
+	{
+		len = snprintf(buf, sizeof(buf), "%s bestmove %s score %lld depth %lld nodes %lld pv", a->label,
+					   best, result[RESULT_SCORE], result[RESULT_DEPTH], result[RESULT_NODES]);
+	}
+	else if (loss >= queue->threshold && loss > 0)
+	{
+		queue->nr_blunders++;
+		get_move_string(a->played, move);
+		len = snprintf(buf, sizeof(buf), "%s played %.2s score %lld bestmove %s score %lld loss %lld depth %lld pv",
+					   a->label, move, result[RESULT_PLAYED_SCORE], best, result[RESULT_SCORE], loss, result[RESULT_DEPTH]);
 	}
 	else
 	{
-		fprintf(*fp, "Arguments: <ip> <port> <time_limit> <filename> \n");
+		return strdup("");
 	}
 
-	return result;
-}
-
-void initialise_board(void)
-{
-	int i;
-	board = (int *)malloc(BOARDSIZE * sizeof(int));
-	for (i = 0; i <= 9; i++)
-		board[i] = OUTER;
-	for (i = 10; i <= 89; i++)
+	for (i = 0; i < result[RESULT_PV_LENGTH]; i++)
 	{
-		if (i % 10 >= 1 && i % 10 <= 8)
-			board[i] = EMPTY;
-		else
-			board[i] = OUTER;
+		get_move_string(result[RESULT_SIZE + i], move);
+		len += snprintf(buf + len, sizeof(buf) - len, " %.2s", move);
 	}
-	for (i = 90; i <= 99; i++)
-		board[i] = OUTER;
-	board[44] = WHITE;
-	board[45] = BLACK;
-	board[54] = BLACK;
-	board[55] = WHITE;
+	snprintf(buf + len, sizeof(buf) - len, "\n");
+	return strdup(buf);
 }
 
-void free_board(void)
+/**
+ *   Rank i (i != 0) in analysis mode: analyses the positions rank 0 sends until it sends index -1
+ */
+void analyse_worker(void)
 {
-	free(board);
+	int *msg = (int *)malloc((ANALYSE_SIZE + BOARDSIZE) * sizeof(int));
+	long long result[RESULT_SIZE + STATS_MAX_PLY];
+	long long nodes;
+
+	for (;;)
+	{
+		TRACE_BEGIN(TRACE_IDLE, -1);
+		MPI_Recv(msg, ANALYSE_SIZE + BOARDSIZE, MPI_INT, 0, TAG_ANALYSE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		TRACE_END(TRACE_IDLE);
+		if (msg[ANALYSE_INDEX] < 0)
+			break;
+
+		memcpy(board, msg + ANALYSE_SIZE, BOARDSIZE * sizeof(int));
+		nodes = ((long long)msg[ANALYSE_NODES_HIGH] << 31) | msg[ANALYSE_NODES_LOW];
+		analyse(msg[ANALYSE_COLOUR], msg[ANALYSE_DEPTH], nodes, msg[ANALYSE_PLAYED], result);
+		result[RESULT_INDEX] = msg[ANALYSE_INDEX];
+		MPI_Send(result, RESULT_SIZE + result[RESULT_PV_LENGTH], MPI_LONG_LONG, 0, TAG_RESULT, MPI_COMM_WORLD);
+	}
+	free(msg);
 }
 
 /**
- *   Rank i (i != 0) executes this code
- *   ----------------------------------
- *   Called at the start of execution on all ranks except for rank 0.
- *   - run_worker should play minimax from its move(s)
- *   - results should be send to Rank 0 for final selection of a move
+ *   Searches the board for colour on this rank alone, with iterative deepening up to depth
+ *   and within node_limit nodes if that is not 0 (depth 0 solves it, see solve_position),
+ *   and fills in a TAG_RESULT message except for its index. The result is that of the deepest complete iteration (the first one if
+ *   even that ran out of nodes); its principal variation starts with the best move and is
+ *   empty to pass. If played is not -1, its score in that iteration is included as well.
  */
-void run_worker(int rank)
+void analyse(int colour, int depth, long long node_limit, int played, long long *result)
 {
-	/////////////////////used in debugging the program
-	switch (rank)
+	int *moves, *prev_board;
+	int line[STATS_MAX_PLY];
+	int line_len = 0;
+	int iteration_best, iteration_played, score, d, i, tmp;
+	int perf_prev;
+
+	if (depth == 0)
 	{
-	case 1:
-		fprintf(fptr_debug1, "Hello from Proc 1\n");
-		break;
-	case 2:
-		fprintf(fptr_debug2, "Hello from Proc 2\n");
-		break;
-	case 3:
-		fprintf(fptr_debug3, "Hello from Proc 3\n");
-		break;
+		solve_position(colour, result);
+		return;
 	}
-	/////////////////////
-
-	int running = 0;
-	int my_colour;
-	FILE *fp = NULL;
-	int my_loc = -1;
-	int my_score = -10000000;
-	int max_score = -10000000;
-	int max_loc = -1;
-	int *legalmoves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-	memset(legalmoves, 0, LEGALMOVSBUFSIZE);
-	int *best_scores = (int *)malloc(nr_of_procs * sizeof(int));
-	int *best_locs = (int *)malloc(nr_of_procs * sizeof(int));
-	int *prev_board;
-
-	/*broadcast colour*/
-	MPI_Bcast(&my_colour, 1, MPI_INT, 0, MPI_COMM_WORLD);
-	/*broadcast running*/
-	MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-	while (running == 1)
+	moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
+	prev_board = (int *)malloc(BOARDSIZE * sizeof(int));
+	stats_reset();
+	search_time_limit = 0;
+	search_stoppable = 0;
+	search_node_limit = node_limit;
+	stop_search = 0;
+	start_time = MPI_Wtime();
+
+	result[RESULT_MOVE] = -1;
+	result[RESULT_DEPTH] = 0;
+	result[RESULT_PV_LENGTH] = 0;
+	result[RESULT_PLAYED_SCORE] = 0;
+
+	legal_moves(colour, moves, NULL);
+	if (played == -1)
+		sym_unique_moves(board, moves);
+	if (moves[0] == 0)
+		result[RESULT_SCORE] = updated_evaluation(colour);
+
+	for (d = 1; d <= depth && moves[0] > 0 && !stop_search; d++)
 	{
-		/*broadcast the board*/
-		MPI_Bcast(board, BOARDSIZE, MPI_INT, 0, MPI_COMM_WORLD);
-
-		/*generate a move*/
-		legal_moves(my_colour, legalmoves, fp);
-
-		if (legalmoves[0] > 0)
+		search_depth = d;
+		iteration_best = INT_MIN;
+		iteration_played = 0;
+		for (i = 1; i <= moves[0]; i++)
 		{
-			for (int i = 1; i <= legalmoves[0]; i++)
-			{
-				if ((i % nr_of_procs) == rank)
-				{
-					my_loc = legalmoves[i];
-
-					/////////////////////used in debugging the program
-					// switch (rank)
-					// {
-					// case 1:
-					// 	printf("Proc 1 has received loc: %d\n", my_loc);
-					// 	break;
-					// case 2:
-					// 	printf("Proc 2 has received loc: %d\n", my_loc);
-					// 	break;
-					// case 3:
-					// 	printf("Proc 3 has received loc: %d\n", my_loc);
-					// 	break;
-					// }
-					/////////////////////
-
-					start_time = MPI_Wtime();
-
-					prev_board = (int *)malloc(BOARDSIZE * sizeof(int));
-					memcpy(prev_board, board, BOARDSIZE * sizeof(int));
-
-					make_move(my_loc, my_colour, fp);
+			perf_prev = PERF_ENTER(PERF_SEARCH);
+			memcpy(prev_board, board, BOARDSIZE * sizeof(int));
+			make_move(moves[i], colour, NULL);
 
-					my_score = minimax(my_loc, my_colour, DEPTH, INT_MIN, INT_MAX, 1);
+			TRACE_BEGIN(TRACE_MINIMAX, moves[i]);
+			score = -negamax(opponent(colour, NULL), d, -SCORE_INF, SCORE_INF);
+			TRACE_END(TRACE_MINIMAX);
 
-					memcpy(board, prev_board, BOARDSIZE * sizeof(int));
+			memcpy(board, prev_board, BOARDSIZE * sizeof(int));
+			PERF_LEAVE(perf_prev);
 
-					if (my_score > max_score)
-					{
-						max_score = my_score;
-						max_loc = my_loc;
-					}
-				}
-				MPI_Bcast(board, BOARDSIZE, MPI_INT, 0, MPI_COMM_WORLD);
+			if (moves[i] == played)
+				iteration_played = score;
+			if (score > iteration_best)
+			{
+				iteration_best = score;
+				line[0] = moves[i];
+				line_len = min(pv_length[1], STATS_MAX_PLY - 1) + 1;
+				memcpy(line + 1, pv[1], (line_len - 1) * sizeof(int));
 			}
 		}
-		else
+
+		/* an iteration cut short by the node budget is only used if there is no other */
+		if (stop_search && d > 1)
+			break;
+		result[RESULT_MOVE] = line[0];
+		result[RESULT_SCORE] = iteration_best;
+		result[RESULT_PLAYED_SCORE] = iteration_played;
+		result[RESULT_DEPTH] = d;
+		result[RESULT_PV_LENGTH] = line_len;
+		for (i = 0; i < line_len; i++)
+			result[RESULT_SIZE + i] = line[i];
+
+		/* the next iteration searches the best move first */
+		for (i = 2; i <= moves[0] && moves[i] != line[0]; i++)
+			;
+		if (i <= moves[0])
 		{
-			max_score = -1;
-			max_loc = -1;
+			tmp = moves[1];
+			moves[1] = moves[i];
+			moves[i] = tmp;
 		}
+	}
+	result[RESULT_NODES] = stats.nodes;
+	stats.search_time += MPI_Wtime() - start_time;
 
-		/////////////////////used in debugging the program
-		// switch (rank)
-		// {
-		// case 1:
-		// 	printf("Proc 1 has max score %d at loc %d\n", max_score, max_loc);
-		// 	break;
-		// case 2:
-		// 	printf("Proc 2 has max score %d at loc %d\n", max_score, max_loc);
-		// 	break;
-		// case 3:
-		// 	printf("Proc 3 has max score %d at loc %d\n", max_score, max_loc);
-		// 	break;
-		// }
-		/////////////////////
-
-		/*gather all options for best score at master process*/
-		MPI_Gather(&max_score, 1, MPI_INT, best_scores, 1, MPI_INT, 0, MPI_COMM_WORLD);
-		/*gather all locations for the best score options at master process*/
-		MPI_Gather(&max_loc, 1, MPI_INT, best_locs, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-		/////////////////////reinitialise variables that will be reused when the while loop continues, and the historic value should NOT be remembered*/
-		max_loc = -1;
-		max_score = -100000;
-		/////////////////////
+	free(moves);
+	free(prev_board);
+}
 
-		/*Broadcast running*/
-		MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
-	}
+/**
+ *   Solves the board for colour exactly on this rank alone and fills in a TAG_RESULT message
+ *   like analyse: the score is the final disc difference (final_score) and the depth the
+ *   number of empty squares.
+ */
+void solve_position(int colour, long long *result)
+{
+	int empties = BOARD_CELLS - count(BLACK, board) - count(WHITE, board);
+	struct tt_entry *entry;
+	int sym, i;
+
+	stats_reset();
+	search_time_limit = 0;
+	search_stoppable = 0;
+	search_node_limit = 0;
+	stop_search = 0;
+	start_time = MPI_Wtime();
+
+	if (colour == BLACK)
+		result[RESULT_SCORE] = solve_black(-SCORE_INF, SCORE_INF, 0, empties, 0);
+	else
+		result[RESULT_SCORE] = solve_white(-SCORE_INF, SCORE_INF, 0, empties, 0);
+	result[RESULT_MOVE] = (pv_length[0] > 0) ? pv[0][0] : -1;
+	if (pv_length[0] == 0 && any_move(colour) && (entry = tt_probe(tt_hash(board, colour, &sym))) != NULL)
+		result[RESULT_MOVE] = sym_loc_inverse(entry->move, sym); // the root was in the table
+	result[RESULT_DEPTH] = empties;
+	result[RESULT_PLAYED_SCORE] = 0;
+	result[RESULT_PV_LENGTH] = pv_length[0];
+	for (i = 0; i < pv_length[0]; i++)
+		result[RESULT_SIZE + i] = pv[0][i];
+	result[RESULT_NODES] = stats.nodes;
+	stats.search_time += MPI_Wtime() - start_time;
 }
 
 /**
@@ -414,22 +2303,28 @@ void run_worker(int rank)
  *  - the ranks may communicate during execution
  *  - final results should be gathered at rank 0 for final selection of a move
  */
-void gen_move_master(char *move, int my_colour, FILE *fp)
+int gen_move_master(char *move, int my_colour, FILE *fp)
 {
 	int my_score;
 	int my_loc;
-	int max_score = -1;
+	int max_score = INT_MIN;
 	int max_loc = -1;
-	int overall_best_score = -100000;
+	int overall_best_score = INT_MIN;
 	int overall_best_loc = -1;
+	int stopped;
+	int sym;
+	uint64_t key;
 	int *legalmoves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
 	memset(legalmoves, 0, LEGALMOVSBUFSIZE);
 	int *best_scores = (int *)malloc(nr_of_procs * sizeof(int));
 	int *best_locs = (int *)malloc(nr_of_procs * sizeof(int));
-	int *prev_board;
+	int *prev_board = (int *)malloc(BOARDSIZE * sizeof(int));
+	int perf_prev;
+	double t;
 
-	/* generate move */
+	/* generate move, a move that a symmetry of the board turns into an earlier one is not searched */
 	legal_moves(my_colour, legalmoves, fp);
+	sym_unique_moves(board, legalmoves);
 
 	if (legalmoves[0] > 0)
 	{
@@ -441,16 +2336,19 @@ void gen_move_master(char *move, int my_colour, FILE *fp)
 				my_loc = legalmoves[i];
 				// printf("Process 0 received legalmove %d\n", my_loc);
 
-				start_time = MPI_Wtime();
-
-				prev_board = (int *)malloc(BOARDSIZE * sizeof(int));
+				t = MPI_Wtime();
+				perf_prev = PERF_ENTER(PERF_SEARCH);
 				memcpy(prev_board, board, BOARDSIZE * sizeof(int));
 
 				make_move(my_loc, my_colour, fp);
 
-				my_score = minimax(my_loc, my_colour, DEPTH, INT_MIN, INT_MAX, 1);
+				TRACE_BEGIN(TRACE_MINIMAX, my_loc);
+				my_score = -negamax(opponent(my_colour, fp), search_depth, -SCORE_INF, SCORE_INF);
+				TRACE_END(TRACE_MINIMAX);
+				stats.search_time += MPI_Wtime() - t;
 
 				memcpy(board, prev_board, BOARDSIZE * sizeof(int));
+				PERF_LEAVE(perf_prev);
 
 				if (my_score > max_score)
 				{
@@ -458,7 +2356,9 @@ void gen_move_master(char *move, int my_colour, FILE *fp)
 					max_loc = my_loc;
 				}
 			}
-			MPI_Bcast(board, BOARDSIZE, MPI_INT, 0, MPI_COMM_WORLD);
+			TRACE_BEGIN(TRACE_BCAST, -1);
+			STATS_MPI(MPI_Bcast(board, BOARDSIZE, MPI_INT, 0, MPI_COMM_WORLD));
+			TRACE_END(TRACE_BCAST);
 		}
 	}
 	else
@@ -466,14 +2366,21 @@ void gen_move_master(char *move, int my_colour, FILE *fp)
 		max_score = -1;
 		max_loc = -1;
 	}
+	end_search();
 
 	// printf("Proc 0 has max score %d at loc %d\n", max_score, max_loc);
 
+	TRACE_BEGIN(TRACE_GATHER, -1);
 	/*gather all options for best score at master process*/
-	MPI_Gather(&max_score, 1, MPI_INT, best_scores, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	STATS_MPI(MPI_Gather(&max_score, 1, MPI_INT, best_scores, 1, MPI_INT, 0, MPI_COMM_WORLD));
 
 	/*gather all locations for the best score options at master process*/
-	MPI_Gather(&max_loc, 1, MPI_INT, best_locs, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	STATS_MPI(MPI_Gather(&max_loc, 1, MPI_INT, best_locs, 1, MPI_INT, 0, MPI_COMM_WORLD));
+
+	/*a search cut short by the time limit is not kept as the result of the position*/
+	STATS_MPI(MPI_Reduce(&stop_search, &stopped, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD));
+	TRACE_END(TRACE_GATHER);
+	stop_search = stopped; // of any rank, so that a caller sees whether the search was complete
 
 	// for (int i = 0; i < nr_of_procs; i++)
 	// {
@@ -495,24 +2402,221 @@ void gen_move_master(char *move, int my_colour, FILE *fp)
 	// printf("move to make : %d\n", overall_best_loc);
 	// printf("i am here =================================================\n");
 
+	free(legalmoves);
+	free(best_scores);
+	free(best_locs);
+	free(prev_board);
+
+	if (overall_best_loc != -1 && !stopped)
+	{
+		key = tt_hash(board, my_colour, &sym);
+		tt_store(key, search_depth + 1, overall_best_score, TT_EXACT, sym_loc(overall_best_loc, sym));
+	}
+
 	if (overall_best_loc == -1)
 	{
 		// printf("only option is to pass\n");
-		overall_best_score = -100000;
-		overall_best_loc = -1;
 		strncpy(move, "pass\n", MOVEBUFSIZE);
+		return 0;
+	}
+
+	/* apply move */
+	get_move_string(overall_best_loc, move);
+	// printf("MOVE STRING %s", move);
+
+	make_move(overall_best_loc, my_colour, fp);
+
+	return overall_best_score;
+}
+
+/**
+ *   Every rank: its part of the Monte Carlo search of the board for colour (see mcts_search,
+ *   or hybrid_master for ENGINE_MCTS_AB). Returns the location of the best move, -1 for a
+ *   pass, and the share of its playouts won in value (if not NULL); the workers of the hybrid
+ *   search return -1.
+ */
+int mcts_move(int colour, double *value)
+{
+	struct mcts_result result = {-1, 0, 0, 0.5};
+	double t = MPI_Wtime();
+	int perf_prev = PERF_ENTER(PERF_SEARCH);
+
+	TRACE_BEGIN(TRACE_MCTS, -1);
+	if (engine != ENGINE_MCTS_AB)
+		mcts_search(bb_get(board, colour), bb_get(board, opponent(colour, NULL)), search_stopped, &result);
+	else if (my_rank == 0)
+		hybrid_master(colour, &result);
+	else
+		hybrid_worker();
+	TRACE_END(TRACE_MCTS);
+	PERF_LEAVE(perf_prev);
+	stats.search_time += MPI_Wtime() - t;
+	if (value != NULL)
+		*value = result.value;
+	return (result.move >= 0) ? bb_loc(result.move) : -1;
+}
+
+/**
+ *   Rank 0: the Monte Carlo search of the board for colour with every rank, after
+ *   search_master. Plays the move as gen_move_master does and returns its value as a
+ *   score from -100 (every playout lost) to 100 (every playout won).
+ */
+int mcts_master(char *move, int my_colour, FILE *fp)
+{
+	double value;
+	int loc = mcts_move(my_colour, &value);
+
+	end_search();
+	if (loc == -1)
+	{
+		strncpy(move, "pass\n", MOVEBUFSIZE);
+		return 0;
+	}
+	get_move_string(loc, move);
+	make_move(loc, my_colour, fp);
+	return (int)(200 * value - 100);
+}
+
+/**
+ *   Rank 0 in the hybrid search: grows the Monte Carlo tree of the board for colour alone and
+ *   has the workers score its leaves with a shallow alpha-beta search (leaf_score). Every
+ *   worker gets MCTS_LEAVES_PER_WORKER leaves at a time, and a score is taken in as soon as
+ *   it arrives, so the tree keeps growing while the workers search. Rank 0 scores a leaf
+ *   itself whenever no score is waiting. The search ends at the time limit, or after
+ *   MCTS_LEAVES_PER_PLY leaves per ply of the search depth without one.
+ */
+void hybrid_master(int colour, struct mcts_result *result)
+{
+	int *msg = (int *)malloc((LEAF_SIZE + BOARDSIZE) * sizeof(int));
+	int *saved_board = (int *)malloc(BOARDSIZE * sizeof(int));
+	int *sent = (int *)calloc(nr_of_procs, sizeof(int)); // sent[r]: leaves of worker r not yet scored
+	int reply[LEAF_SCORE_SIZE];
+	long long leaves = 0, leaf_limit = (search_time_limit == 0) ? (long long)search_depth * MCTS_LEAVES_PER_PLY : 0;
+	int in_flight = 0, leaf, flag, stopped, score, r;
+	bitboard own, opp;
+	MPI_Status status;
+
+	memcpy(saved_board, board, BOARDSIZE * sizeof(int));
+	memcpy(msg + LEAF_SIZE, board, BOARDSIZE * sizeof(int)); // the border squares
+	if (mcts_start(bb_get(board, colour), bb_get(board, opponent(colour, NULL))) > 1)
+	{
+		while (!search_stopped() && (leaf_limit == 0 || leaves < leaf_limit))
+		{
+			for (r = 1; r < nr_of_procs; r++)
+			{
+				while (sent[r] < MCTS_LEAVES_PER_WORKER && (leaf = mcts_select(&own, &opp)) >= 0)
+				{
+					msg[LEAF_INDEX] = leaf;
+					set_board_bitboards(msg + LEAF_SIZE, own, opp);
+					STATS_MPI(MPI_Send(msg, LEAF_SIZE + BOARDSIZE, MPI_INT, r, TAG_LEAF, MPI_COMM_WORLD));
+					sent[r]++;
+					in_flight++;
+				}
+			}
+
+			STATS_MPI(MPI_Iprobe(MPI_ANY_SOURCE, TAG_LEAF_SCORE, MPI_COMM_WORLD, &flag, &status));
+			if (flag)
+			{
+				STATS_MPI(MPI_Recv(reply, LEAF_SCORE_SIZE, MPI_INT, status.MPI_SOURCE, TAG_LEAF_SCORE, MPI_COMM_WORLD, MPI_STATUS_IGNORE));
+				sent[status.MPI_SOURCE]--;
+				in_flight--;
+				if (reply[LEAF_SCORE_STOPPED])
+					mcts_cancel(reply[LEAF_SCORE_INDEX]);
+				else
+					mcts_update(reply[LEAF_SCORE_INDEX], reply[LEAF_SCORE_SCORE]);
+				leaves++;
+				continue;
+			}
+
+			leaf = mcts_select(&own, &opp);
+			if (leaf < 0 && in_flight == 0)
+				break; // every line of the tree ends the game
+			if (leaf < 0)
+				continue;
+			score = leaf_score(own, opp, &stopped);
+			if (stopped)
+				mcts_cancel(leaf);
+			else
+				mcts_update(leaf, score);
+			leaves++;
+		}
+	}
+
+	/* no more leaves, the workers answer the ones they have first */
+	msg[LEAF_INDEX] = -1;
+	for (r = 1; r < nr_of_procs; r++)
+		STATS_MPI(MPI_Send(msg, LEAF_SIZE + BOARDSIZE, MPI_INT, r, TAG_LEAF, MPI_COMM_WORLD));
+	while (in_flight-- > 0)
+	{
+		STATS_MPI(MPI_Recv(reply, LEAF_SCORE_SIZE, MPI_INT, MPI_ANY_SOURCE, TAG_LEAF_SCORE, MPI_COMM_WORLD, MPI_STATUS_IGNORE));
+		if (reply[LEAF_SCORE_STOPPED])
+			mcts_cancel(reply[LEAF_SCORE_INDEX]);
+		else
+			mcts_update(reply[LEAF_SCORE_INDEX], reply[LEAF_SCORE_SCORE]);
 	}
-	else if (overall_best_loc != -1)
+
+	mcts_result(result);
+	memcpy(board, saved_board, BOARDSIZE * sizeof(int));
+	free(msg);
+	free(saved_board);
+	free(sent);
+}
+
+/**
+ *   A worker in the hybrid search: scores the leaves of rank 0 until it sends index -1
+ */
+void hybrid_worker(void)
+{
+	int *msg = (int *)malloc((LEAF_SIZE + BOARDSIZE) * sizeof(int));
+	int reply[LEAF_SCORE_SIZE];
+
+	for (;;)
 	{
-		/* apply move */
-		get_move_string(overall_best_loc, move);
-		// printf("MOVE STRING %s", move);
+		STATS_MPI(MPI_Recv(msg, LEAF_SIZE + BOARDSIZE, MPI_INT, 0, TAG_LEAF, MPI_COMM_WORLD, MPI_STATUS_IGNORE));
+		if (msg[LEAF_INDEX] < 0)
+			break;
+		memcpy(board, msg + LEAF_SIZE, BOARDSIZE * sizeof(int));
+		reply[LEAF_SCORE_INDEX] = msg[LEAF_INDEX];
+		reply[LEAF_SCORE_SCORE] = leaf_score(bb_get(board, BLACK), bb_get(board, WHITE), &reply[LEAF_SCORE_STOPPED]);
+		STATS_MPI(MPI_Send(reply, LEAF_SCORE_SIZE, MPI_INT, 0, TAG_LEAF_SCORE, MPI_COMM_WORLD));
+	}
+	free(msg);
+}
+
+/**
+ *   Every rank: the score of a leaf of the hybrid search with the discs own of the side to
+ *   move and opp of the other side, by a negamax search MCTS_LEAF_DEPTH deep. The board
+ *   becomes the leaf with own as black, which is the same game. stopped is set when the
+ *   search was cut short.
+ */
+int leaf_score(bitboard own, bitboard opp, int *stopped)
+{
+	int score;
+
+	set_board_bitboards(board, own, opp);
+	search_depth = MCTS_LEAF_DEPTH;
+	TRACE_BEGIN(TRACE_MINIMAX, -1);
+	score = negamax(BLACK, MCTS_LEAF_DEPTH, -SCORE_INF, SCORE_INF);
+	TRACE_END(TRACE_MINIMAX);
+	*stopped = stop_search;
+	return score;
+}
 
-		make_move(overall_best_loc, my_colour, fp);
+/* sets the squares and the bitboards of board b (board.h) to the discs black and white */
+void set_board_bitboards(int *b, bitboard black, bitboard white)
+{
+	int row, col, sq;
 
-		overall_best_score = -100000;
-		overall_best_loc = -1;
+	for (row = 0; row < BOARD_N; row++)
+	{
+		for (col = 0; col < BOARD_N; col++)
+		{
+			sq = row * BITBOARD_STRIDE + col;
+			b[BOARD_LOC(row, col)] = ((black >> sq) & 1) ? BLACK : ((white >> sq) & 1) ? WHITE : EMPTY;
+		}
 	}
+	bb_set(b, BLACK, black);
+	bb_set(b, WHITE, white);
 }
 
 void apply_opp_move(char *move, int my_colour, FILE *fp)
@@ -528,16 +2632,23 @@ void apply_opp_move(char *move, int my_colour, FILE *fp)
 
 void game_over(void)
 {
+	TRACE_FINALIZE(trace_filename);
+	PERF_FINALIZE();
+	log_finalize();
+	free(trace_filename);
 	free_board();
+	tt_free();
+	mcts_free();
+	experience_close();
+	book_close();
 	MPI_Finalize();
 }
 
 void get_move_string(int loc, char *ms)
 {
-	int row, col, new_loc;
-	new_loc = loc - (9 + 2 * (loc / 10));
-	row = new_loc / 8;
-	col = new_loc % 8;
+	int row, col;
+	row = BOARD_ROW(loc);
+	col = BOARD_COL(loc);
 	ms[0] = row + '0';
 	ms[1] = col + '0';
 	ms[2] = '\n';
@@ -550,68 +2661,49 @@ int get_loc(char *movestring)
 	/* movestring of form "xy", x = row and y = column */
 	row = movestring[0] - '0';
 	col = movestring[1] - '0';
-	return (10 * (row + 1)) + col + 1;
+	return BOARD_LOC(row, col);
 }
 
-void legal_moves(int player, int *moves, FILE *fp)
+/**
+ *   The square (row * BOARD_N + column) of a move string as used by the referee, -1 for a pass
+ */
+int move_square(const char *movestring)
 {
-	int move, i;
-	moves[0] = 0;
-	i = 0;
-	for (move = 11; move <= 88; move++)
-	{
-		if (legalp(move, player, fp))
-		{
-			i++;
-			moves[i] = move;
-		}
-	}
-	moves[0] = i;
+	if (strncmp(movestring, "pass", 4) == 0)
+		return -1;
+	return (movestring[0] - '0') * BOARD_N + (movestring[1] - '0');
 }
 
-int legalp(int move, int player, FILE *fp)
+/* the moves in ascending order of square, from the bitboards (bitboard.h) */
+void legal_moves(int player, int *moves, FILE *fp)
 {
-	int i;
-	if (!validp(move))
-		return 0;
-	if (board[move] == EMPTY)
-	{
-		i = 0;
-		while (i <= 7 && !would_flip(move, ALLDIRECTIONS[i], player, fp))
-			i++;
-		if (i == 8)
-			return 0;
-		else
-			return 1;
-	}
-	else
-		return 0;
+	int i = 0;
+	int perf_prev = PERF_ENTER(PERF_MOVEGEN);
+	bitboard m = bb_moves(bb_get(board, player), bb_get(board, opponent(player, fp)));
+
+	for (; m != 0; m &= m - 1)
+		moves[++i] = bb_loc(bb_first(m));
+	moves[0] = i;
+	PERF_LEAVE(perf_prev);
 }
 
-int validp(int move)
+int legalp(int move, int player, FILE *fp)
 {
-	if ((move >= 11) && (move <= 88) && (move % 10 >= 1) && (move % 10 <= 8))
-		return 1;
-	else
+	if (!validp(move) || board[move] != EMPTY)
 		return 0;
+	return (bb_moves(bb_get(board, player), bb_get(board, opponent(player, fp))) >> bb_square(move)) & 1;
 }
 
-int would_flip(int move, int dir, int player, FILE *fp)
+/* 1 if player has a legal move on the board */
+int any_move(int player)
 {
-	int c;
-	c = move + dir;
-	if (board[c] == opponent(player, fp))
-		return find_bracket_piece(c + dir, dir, player, fp);
-	else
-		return 0;
+	return bb_moves(bb_get(board, player), bb_get(board, opponent(player, NULL))) != 0;
 }
 
-int find_bracket_piece(int square, int dir, int player, FILE *fp)
+int validp(int move)
 {
-	while (validp(square) && board[square] == opponent(player, fp))
-		square = square + dir;
-	if (validp(square) && board[square] == player)
-		return square;
+	if ((move >= BOARD_FIRST) && (move <= BOARD_LAST) && (BOARD_COL(move) >= 0) && (BOARD_COL(move) < BOARD_N))
+		return 1;
 	else
 		return 0;
 }
@@ -622,46 +2714,42 @@ int opponent(int player, FILE *fp)
 		return WHITE;
 	if (player == WHITE)
 		return BLACK;
-	fprintf(fp, "illegal player\n");
+	LOG_ERROR("illegal player\n");
 	return EMPTY;
 }
 
+/* flips with the bitboards, then writes the flipped squares to the mailbox */
 void make_move(int move, int player, FILE *fp)
 {
-	int i;
+	int perf_prev = PERF_ENTER(PERF_MAKE);
+	int other = opponent(player, fp);
+	int sq = bb_square(move);
+	bitboard own = bb_get(board, player);
+	bitboard opp = bb_get(board, other);
+	bitboard flips = bb_flips(sq, own, opp);
+
+	bb_set(board, player, own | flips | ((bitboard)1 << sq));
+	bb_set(board, other, opp & ~flips);
 	board[move] = player;
-	for (i = 0; i <= 7; i++)
-		make_flips(move, ALLDIRECTIONS[i], player, fp);
-}
-
-void make_flips(int move, int dir, int player, FILE *fp)
-{
-	int bracketer, c;
-	bracketer = would_flip(move, dir, player, fp);
-	if (bracketer)
-	{
-		c = move + dir;
-		do
-		{
-			board[c] = player;
-			c = c + dir;
-		} while (c != bracketer);
-	}
+	for (; flips != 0; flips &= flips - 1)
+		board[bb_loc(bb_first(flips))] = player;
+	PERF_LEAVE(perf_prev);
 }
 
-void print_board(FILE *fp)
+void print_board(FILE *fp, int *board)
 {
 	int row, col;
-	fprintf(fp, "   1 2 3 4 5 6 7 8 [%c=%d %c=%d]\n",
-			nameof(BLACK), count(BLACK, board), nameof(WHITE), count(WHITE, board));
-	for (row = 1; row <= 8; row++)
+	fprintf(fp, "  ");
+	for (col = 1; col <= BOARD_N; col++)
+		fprintf(fp, "%2d", col);
+	fprintf(fp, " [%c=%d %c=%d]\n", nameof(BLACK), count(BLACK, board), nameof(WHITE), count(WHITE, board));
+	for (row = 1; row <= BOARD_N; row++)
 	{
-		fprintf(fp, "%d  ", row);
-		for (col = 1; col <= 8; col++)
-			fprintf(fp, "%c ", nameof(board[col + (10 * row)]));
+		fprintf(fp, "%-3d", row);
+		for (col = 1; col <= BOARD_N; col++)
+			fprintf(fp, "%c ", nameof(board[col + (BOARD_WIDTH * row)]));
 		fprintf(fp, "\n");
 	}
-	fflush(fp);
 }
 
 char nameof(int piece)
@@ -672,109 +2760,184 @@ char nameof(int piece)
 
 int count(int player, int *board)
 {
-	int i, cnt;
-	cnt = 0;
-	for (i = 1; i <= 88; i++)
-		if (board[i] == player)
-			cnt++;
-	return cnt;
+	return bb_count(bb_get(board, player));
 }
 
 /*
-	Function runs the recursive minimax algorithm with alpha beta pruning.
+	Function runs the recursive negamax algorithm with alpha beta pruning on the board with colour
+	to move, one specialised function per colour (negamax.h).
 	Parameters:
-		loc - the current move that is being played.
+		colour - the side to move.
 		depth - depth of the search into the tree.
 		alpha - the alpha value used in the pruning.
 		beta - the beta value used in the pruning
 	Returns:
-		Result - Score based on the evalaution function and minimax algorithm.
+		Result - Score of the evaluation function for colour, backed up by the negamax algorithm.
 */
-int minimax(int loc, int my_colour, int depth, int alpha, int beta, int MaximisingPlayer)
+int negamax(int colour, int depth, int alpha, int beta)
 {
-	FILE *fp = NULL;
-	int best_score = -1;
-	int child_score;
-	int *childMoves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-	int *original_board;
-	int time_elapsed = 0;
-	int result;
+	return (colour == BLACK) ? negamax_black(depth, alpha, beta) : negamax_white(depth, alpha, beta);
+}
+
+#define NEGAMAX negamax_black
+#define NEGAMAX_OTHER negamax_white
+#define SIDE 1
+#define OTHER 2
+#include "negamax.h"
+#undef NEGAMAX
+#undef NEGAMAX_OTHER
+#undef SIDE
+#undef OTHER
+
+#define NEGAMAX negamax_white
+#define NEGAMAX_OTHER negamax_black
+#define SIDE 2
+#define OTHER 1
+#include "negamax.h"
+#undef NEGAMAX
+#undef NEGAMAX_OTHER
+#undef SIDE
+#undef OTHER
+
+#define SOLVE solve_black
+#define SOLVE_OTHER solve_white
+#define SIDE 1
+#define OTHER 2
+#include "solve.h"
+#undef SOLVE
+#undef SOLVE_OTHER
+#undef SIDE
+#undef OTHER
+
+#define SOLVE solve_white
+#define SOLVE_OTHER solve_black
+#define SIDE 2
+#define OTHER 1
+#include "solve.h"
+#undef SOLVE
+#undef SOLVE_OTHER
+#undef SIDE
+#undef OTHER
+
+/*
+	Looks the position up in the transposition table. Returns 1 with its score in *score when the
+	entry is as deep as depth and its bound decides the node, and sets *move to the best move
+	of the entry (-1 without one). Scores of the table and of negamax are both from the side to move.
+*/
+int probe_node(uint64_t key, int depth, int alpha, int beta, int *score, int *move)
+{
+	struct tt_entry *entry;
+
+	stats.tt_probes++;
+	entry = tt_probe(key);
+	*move = -1;
+	if (entry == NULL)
+		return 0;
+	*move = entry->move;
+	*score = entry->score;
+	if (entry->depth < depth ||
+		!(entry->flag == TT_EXACT || (entry->flag == TT_LOWER && *score >= beta) || (entry->flag == TT_UPPER && *score <= alpha)))
+		return 0;
+	stats.tt_hits++;
+	return 1;
+}
+
+/*
+	Stores the result of a node searched with the window (alpha, beta) in the transposition table,
+	unless the search was stopped and the score may be wrong. The move is turned by sym like the key.
+*/
+void store_node(uint64_t key, int sym, int depth, int score, int alpha, int beta, int move, int tt_move, int ply)
+{
+	int flag = TT_EXACT;
+
+	if (tt_move != -1 && move == tt_move)
+		stats.plies[ply].tt_move_best++;
+	if (stop_search)
+		return;
+	if (score <= alpha)
+		flag = TT_UPPER;
+	else if (score >= beta)
+		flag = TT_LOWER;
+	tt_store(key, depth, score, flag, sym_loc(move, sym));
+}
+
+/*
+	The final disc difference for the owner of own of a game over with the discs own and opp, the empty
+	squares count for the winner.
+*/
+int final_score(bitboard own, bitboard opp)
+{
+	int mine = bb_count(own);
+	int theirs = bb_count(opp);
+	int empty = BOARD_CELLS - mine - theirs;
+
+	if (mine > theirs)
+		return mine - theirs + empty;
+	if (mine < theirs)
+		return mine - theirs - empty;
+	return 0;
+}
 
-	time_elapsed = MPI_Wtime() - start_time;
+/*
+	Sorts moves[from..moves[0]] of the owner of own by the number of replies of the opponent, fewest
+	first: the endgame solver proves a cutoff sooner after the moves that leave the opponent little
+	choice. The replies are counted on the bitboards, the board is not touched.
+*/
+void order_fastest_first(int *moves, bitboard own, bitboard opp, int from)
+{
+	int replies[BOARD_CELLS + 1];
+	int i, j, move, n, sq;
+	bitboard flips;
 
-	if (depth == 0 || loc == -1 || time_elapsed >= (time_limit - TIME_OFFSET))
+	for (i = from; i <= moves[0]; i++)
 	{
-		result = updated_evaluation(my_colour);
-		// memcpy(board, original_board, BOARDSIZE * sizeof(int));
-		return result;
+		sq = bb_square(moves[i]);
+		flips = bb_flips(sq, own, opp);
+		replies[i] = bb_count(bb_moves(opp & ~flips, own | flips | ((bitboard)1 << sq)));
 	}
-
-	if (MaximisingPlayer)
+	for (i = from + 1; i <= moves[0]; i++)
 	{
-		best_score = INT_MIN;
-		legal_moves(my_colour, childMoves, fp);
-		if (childMoves[0] == 0)
-		{
-			result = updated_evaluation(my_colour);
-			return result;
-		}
-		else
+		move = moves[i];
+		n = replies[i];
+		for (j = i; j > from && replies[j - 1] > n; j--)
 		{
-			for (int i = 1; i <= childMoves[0]; i++)
-			{
-				original_board = (int *)malloc(BOARDSIZE * sizeof(int));
-				memcpy(original_board, board, BOARDSIZE * sizeof(int));
-				make_move(childMoves[i], my_colour, fp);
-
-				child_score = minimax(childMoves[i], my_colour, depth - 1, alpha, beta, 0);
-				best_score = max(child_score, best_score);
-				alpha = max(alpha, child_score);
-				memcpy(board, original_board, BOARDSIZE * sizeof(int));
-				if (beta <= alpha)
-				{
-					break;
-				}
-			}
-			free(childMoves);
-			free(original_board);
-
-			return best_score;
+			moves[j] = moves[j - 1];
+			replies[j] = replies[j - 1];
 		}
+		moves[j] = move;
+		replies[j] = n;
 	}
-	else if (!MaximisingPlayer)
+}
+
+/*
+	Moves the move of the transposition table to the front of moves (moves[0] is their number).
+*/
+void order_moves(int *moves, int tt_move, int ply)
+{
+	int i;
+
+	for (i = 1; i <= moves[0]; i++)
 	{
-		best_score = INT_MAX;
-		legal_moves(opponent(my_colour, fp), childMoves, fp);
-		if (childMoves[0] == 0)
-		{
-			result = updated_evaluation(my_colour);
-			return result;
-		}
-		else
+		if (moves[i] == tt_move)
 		{
-			for (int i = 1; i <= childMoves[0]; i++)
-			{
-				original_board = (int *)malloc(BOARDSIZE * sizeof(int));
-				memcpy(original_board, board, BOARDSIZE * sizeof(int));
-				make_move(childMoves[i], opponent(my_colour, fp), fp);
-
-				child_score = minimax(childMoves[i], my_colour, depth - 1, alpha, beta, 1);
-				best_score = min(child_score, best_score);
-				beta = min(beta, child_score);
-				memcpy(board, original_board, BOARDSIZE * sizeof(int));
-				if (beta <= alpha)
-				{
-					break;
-				}
-			}
-			free(original_board);
-			free(childMoves);
-
-			return best_score;
+			moves[i] = moves[1];
+			moves[1] = tt_move;
+			stats.plies[ply].tt_moves++;
+			return;
 		}
 	}
+}
 
-	return -1;
+/*
+	Makes move, followed by the principal variation of the next ply, the principal variation of ply.
+*/
+void update_pv(int ply, int move)
+{
+	int len = min(pv_length[ply + 1], STATS_MAX_PLY - 1);
+
+	pv[ply][0] = move;
+	memcpy(pv[ply] + 1, pv[ply + 1], len * sizeof(int));
+	pv_length[ply] = len + 1;
 }
 
 /*
@@ -809,7 +2972,19 @@ int min(int x, int y)
 
 int updated_evaluation(int my_colour)
 {
-	FILE *fp = NULL;
+	int perf_prev = PERF_ENTER(PERF_EVAL);
+	int heuristic_eval = evaluate_bitboards(bb_get(board, my_colour), bb_get(board, opponent(my_colour, NULL)));
+
+	PERF_LEAVE(perf_prev);
+	return heuristic_eval;
+}
+
+/*
+	The evaluation of updated_evaluation for the side with the discs own, the other side has opp.
+	Reads no global state, so the threads of the Monte Carlo search can call it too.
+*/
+int evaluate_bitboards(bitboard own, bitboard opp)
+{
 	int my_count;
 	int opp_count;
 	int coin_parity = 0;
@@ -825,77 +3000,64 @@ int updated_evaluation(int my_colour)
 	int my_edges = 0;
 	int opp_edges = 0;
 	int edges_heuristic = 0;
-	int i;
-	int *moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-	memset(moves, 0, LEGALMOVSBUFSIZE);
+	int i, row, col;
 
 	//////////////////////////*Coin parity*/
-	my_count = count(BLACK, board);
-	opp_count = count(WHITE, board);
+	my_count = bb_count(own);
+	opp_count = bb_count(opp);
 
 	coin_parity = 100 * (my_count - opp_count) / (my_count + opp_count);
 	//////////////////////////
 
 	//////////////////////////*Mobility heuristic*/
-	legal_moves(my_colour, moves, fp);
-	my_moves = moves[0];
-	legal_moves(opponent(my_colour, fp), moves, fp);
-	opp_moves = moves[0];
+	my_moves = bb_count(bb_moves(own, opp));
+	opp_moves = bb_count(bb_moves(opp, own));
 	if (my_moves > opp_moves)
 		mobility_heuristic = (100.0 * my_moves) / (my_moves + opp_moves);
 	else if (my_moves < opp_moves)
 		mobility_heuristic = -(100.0 * opp_moves) / (my_moves + opp_moves);
-	free(moves);
 	//////////////////////////
 
-	int s_weights[] = {
-		0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-		0, 4, -3, 2, 2, 2, 2, -3, 4, 0,
-		0, -3, -4, -1, -1, -1, -1, -4, -3, 0,
-		0, 2, -1, 1, 0, 0, 1, -1, 2, 0,
-		0, 2, -1, 0, 1, 1, 0, -1, 2, 0,
-		0, 2, -1, 0, 1, 1, 0, -1, 2, 0,
-		0, 2, -1, 1, 0, 0, 1, -1, 2, 0,
-		0, -3, -4, -1, -1, -1, -1, -4, -3, 0,
-		0, 4, -3, 2, 2, 2, 2, -3, 4, 0,
-		0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-
-	for (i = 0; i < BOARDSIZE; i++)
+	for (i = BOARD_FIRST; i <= BOARD_LAST; i++)
 	{
-		if (i == 11 || i == 18 || i == 81 || i == 88)
+		row = BOARD_ROW(i);
+		col = BOARD_COL(i);
+		if (col < 0 || col >= BOARD_N)
+			continue; // the border between two rows, its bits belong to other squares
+		if ((row == 0 || row == BOARD_N - 1) && (col == 0 || col == BOARD_N - 1))
 		{
-			if (board[i] == my_colour)
+			if ((own >> bb_square(i)) & 1)
 			{
 				my_corners = my_corners + 11;
 				my_stability += (s_weights[i]) * CORNER_WEIGHT;
 			}
-			else if (board[i] == opponent(my_colour, fp))
+			else if ((opp >> bb_square(i)) & 1)
 			{
 				opp_corners = opp_corners + 11;
 				opp_stability += (s_weights[i]) * CORNER_WEIGHT;
 			}
 		}
-		else if (i % 10 == 1 || i % 10 == 8)
+		else if (col == 0 || col == BOARD_N - 1)
 		{
-			if (board[i] == my_colour)
+			if ((own >> bb_square(i)) & 1)
 			{
 				my_edges = my_edges + 6;
 				my_stability += (s_weights[i]) * EDGE_WEIGHT;
 			}
-			else if (board[i] == opponent(my_colour, fp))
+			else if ((opp >> bb_square(i)) & 1)
 			{
 				opp_edges = opp_edges + 6;
 				opp_stability += (s_weights[i]) * EDGE_WEIGHT;
 			}
 		}
-		else if ((i > 11 && i < 18) || (i > 81 && i < 88))
+		else if (row == 0 || row == BOARD_N - 1)
 		{
-			if (board[i] == my_colour)
+			if ((own >> bb_square(i)) & 1)
 			{
 				my_edges = my_edges + 6;
 				my_stability += (s_weights[i]) * EDGE_WEIGHT;
 			}
-			else if (board[i] == opponent(my_colour, fp))
+			else if ((opp >> bb_square(i)) & 1)
 			{
 				opp_edges = opp_edges + 6;
 				opp_stability += (s_weights[i]) * EDGE_WEIGHT;
@@ -903,11 +3065,11 @@ int updated_evaluation(int my_colour)
 		}
 		else
 		{
-			if (board[i] == my_colour)
+			if ((own >> bb_square(i)) & 1)
 			{
 				my_stability += (s_weights[i]) * INTERIOR_WEIGHT;
 			}
-			else if (board[i] == opponent(my_colour, fp))
+			else if ((opp >> bb_square(i)) & 1)
 			{
 				opp_stability += (s_weights[i]) * INTERIOR_WEIGHT;
 			}
@@ -929,6 +3091,5 @@ int updated_evaluation(int my_colour)
 		edges_heuristic = 100 * (my_edges - opp_edges) / (my_edges + opp_edges);
 	}
 
-	int heuristic_eval = coin_parity + mobility_heuristic + stability_heuristic + corner_heuristic + edges_heuristic;
-	return heuristic_eval;
+	return coin_parity + mobility_heuristic + stability_heuristic + corner_heuristic + edges_heuristic;
 }
@@ -0,0 +1,132 @@
+/*
+ * Negamax search of one side to move, included by my_player.c once for each colour.
+ * The includer defines
+ *   NEGAMAX        name of the function generated
+ *   NEGAMAX_OTHER  the function of the other side, called for the replies
+ *   SIDE, OTHER    the colours (1 black, 2 white) of the side to move and its opponent
+ * as constants, so the colour of every call below is known at compile time and the search
+ * has no colour or max/min branches. There is no include guard on purpose.
+ *
+ * Scores are from SIDE's point of view, a child's score is negated; the evaluation is
+ * antisymmetric, evaluate_bitboards(opp, own) == -evaluate_bitboards(own, opp).
+ * Moves are generated, made and evaluated with the bitboard primitives (bitboard.h) of the
+ * two colours directly, and the child moves and the saved board live on the stack.
+ */
+
+int NEGAMAX(int depth, int alpha, int beta)
+{
+	int best_score = -SCORE_INF;
+	int child_score;
+	int childMoves[LEGALMOVSBUFSIZE];
+	int original_board[BOARDSIZE];
+	bitboard own, opp, flips, moves;
+	int result;
+	int hit;
+	int perf_prev;
+	int ply = min(search_depth - depth + 1, STATS_MAX_PLY - 1); // root moves are at ply 1
+	int alpha0 = alpha;
+	int best_move = -1;
+	int tt_move = -1;
+	int sym;
+	int sq;
+	int i, n;
+	uint64_t key;
+
+	pv_length[ply] = 0;
+	stats.nodes++;
+	stats.plies[ply].nodes++;
+	if (ply > stats.max_depth)
+		stats.max_depth = ply;
+
+	if (depth == 0 || search_stopped())
+	{
+		stats.leaf_evals++;
+		perf_prev = PERF_ENTER(PERF_EVAL);
+		result = evaluate_bitboards(bb_get(board, SIDE), bb_get(board, OTHER));
+		PERF_LEAVE(perf_prev);
+		return result;
+	}
+
+	/* a deep enough result of an earlier search ends the node, its move is searched first */
+	perf_prev = PERF_ENTER(PERF_TT);
+	key = tt_hash(board, SIDE, &sym);
+	hit = probe_node(key, depth, alpha, beta, &result, &tt_move);
+	PERF_LEAVE(perf_prev);
+	if (hit)
+		return result;
+	tt_move = sym_loc_inverse(tt_move, sym);
+
+	perf_prev = PERF_ENTER(PERF_MOVEGEN);
+	moves = bb_moves(bb_get(board, SIDE), bb_get(board, OTHER));
+	for (n = 0; moves != 0; moves &= moves - 1)
+		childMoves[++n] = bb_loc(bb_first(moves));
+	childMoves[0] = n;
+	PERF_LEAVE(perf_prev);
+	order_moves(childMoves, tt_move, ply);
+	if (childMoves[0] == 0)
+	{
+		stats.leaf_evals++;
+		perf_prev = PERF_ENTER(PERF_EVAL);
+		result = evaluate_bitboards(bb_get(board, SIDE), bb_get(board, OTHER));
+		PERF_LEAVE(perf_prev);
+		return result;
+	}
+
+	for (i = 1; i <= childMoves[0]; i++)
+	{
+		/* make_move of SIDE, the mailbox is kept in step though only the bitboards are read */
+		perf_prev = PERF_ENTER(PERF_MAKE);
+		memcpy(original_board, board, BOARDSIZE * sizeof(int));
+		sq = bb_square(childMoves[i]);
+		own = bb_get(board, SIDE);
+		opp = bb_get(board, OTHER);
+		flips = bb_flips(sq, own, opp);
+		bb_set(board, SIDE, own | flips | ((bitboard)1 << sq));
+		bb_set(board, OTHER, opp & ~flips);
+		board[childMoves[i]] = SIDE;
+		for (; flips != 0; flips &= flips - 1)
+			board[bb_loc(bb_first(flips))] = SIDE;
+		PERF_LEAVE(perf_prev);
+
+		/* principal variation search: the first child gets the full window, the others only have to
+		   prove they are no better with a null window and are searched again when one is */
+		if (i == 1)
+			child_score = -NEGAMAX_OTHER(depth - 1, -beta, -alpha);
+		else
+		{
+			stats.plies[ply].null_window_searches++;
+			child_score = -NEGAMAX_OTHER(depth - 1, -alpha - 1, -alpha);
+			if (child_score > alpha && child_score < beta)
+			{
+				stats.plies[ply].re_searches++;
+				child_score = -NEGAMAX_OTHER(depth - 1, -beta, -alpha);
+			}
+		}
+		if (i == 1 || child_score > best_score)
+		{
+			update_pv(ply, childMoves[i]);
+			best_move = childMoves[i];
+			best_score = child_score;
+		}
+		alpha = max(alpha, child_score);
+		perf_prev = PERF_ENTER(PERF_MAKE);
+		memcpy(board, original_board, BOARDSIZE * sizeof(int));
+		PERF_LEAVE(perf_prev);
+		if (beta <= alpha)
+		{
+			stats.cutoffs++;
+			stats.plies[ply].cutoffs++;
+			if (i == 1)
+			{
+				stats.first_move_cutoffs++;
+				stats.plies[ply].first_move_cutoffs++;
+			}
+			break;
+		}
+	}
+
+	perf_prev = PERF_ENTER(PERF_TT);
+	store_node(key, sym, depth, best_score, alpha0, beta, best_move, tt_move, ply);
+	PERF_LEAVE(perf_prev);
+	return best_score;
+}
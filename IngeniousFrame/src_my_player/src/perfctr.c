@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "perfctr.h"
+#include "stats.h"
+
+const char *perf_phase_names[PERF_NR_PHASES] = {"idle", "search", "movegen", "make", "eval", "tt"};
+const char *perf_counter_names[PERF_NR_COUNTERS] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+#ifdef PERFCTR
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+static int fds[PERF_NR_COUNTERS];
+static int current_phase = PERF_IDLE;
+static unsigned long long last[PERF_NR_COUNTERS];
+static int enabled;
+
+static const unsigned long long configs[PERF_NR_COUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES};
+
+static int open_counter(unsigned long long config, int group_fd)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.disabled = (group_fd == -1);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+
+	/* pid 0, cpu -1: count the calling thread on any cpu */
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/* Reads all counters of the group with a single system call */
+static int read_counters(unsigned long long *values)
+{
+	unsigned long long buf[1 + PERF_NR_COUNTERS];
+	int i;
+
+	if (read(fds[0], buf, sizeof(buf)) != (ssize_t)sizeof(buf))
+		return -1;
+	for (i = 0; i < PERF_NR_COUNTERS; i++)
+		values[i] = buf[1 + i];
+	return 0;
+}
+
+/**
+ * Opens the counters of the calling thread as one group,
+ * leaves them disabled (with a message on stderr) if the kernel refuses
+ */
+void perfctr_init(void)
+{
+	int i;
+
+	enabled = 0;
+	fds[0] = open_counter(configs[0], -1);
+	if (fds[0] == -1)
+	{
+		perror("perf_event_open");
+		return;
+	}
+	for (i = 1; i < PERF_NR_COUNTERS; i++)
+	{
+		fds[i] = open_counter(configs[i], fds[0]);
+		if (fds[i] == -1)
+		{
+			perror("perf_event_open");
+			while (--i >= 0)
+				close(fds[i]);
+			return;
+		}
+	}
+	ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	enabled = (read_counters(last) == 0);
+}
+
+/**
+ * Charges the counts since the previous switch to the current phase,
+ * makes phase the current one and returns the previous phase
+ */
+int perfctr_switch(int phase)
+{
+	unsigned long long now[PERF_NR_COUNTERS];
+	int prev = current_phase;
+	int i;
+
+	if (enabled && phase != prev && read_counters(now) == 0)
+	{
+		if (prev != PERF_IDLE)
+		{
+			for (i = 0; i < PERF_NR_COUNTERS; i++)
+				stats.perf[prev][i] += now[i] - last[i];
+		}
+		memcpy(last, now, sizeof(last));
+	}
+	current_phase = phase;
+	return prev;
+}
+
+void perfctr_finalize(void)
+{
+	int i;
+
+	if (!enabled)
+		return;
+	for (i = 0; i < PERF_NR_COUNTERS; i++)
+		close(fds[i]);
+	enabled = 0;
+}
+
+#endif
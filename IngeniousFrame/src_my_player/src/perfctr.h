@@ -0,0 +1,57 @@
+#ifndef _PERFCTR_H
+#define _PERFCTR_H
+
+/**
+ * Hardware performance counters (Linux perf_event_open) attributed to search phases.
+ * Only compiled in when PERFCTR is defined (make PERFCTR=1), otherwise the
+ * PERF_* macros expand to nothing.
+ *
+ * The counters are read at every phase switch and the difference is charged to
+ * the phase that was active, so a phase nested in another one (e.g. move generation
+ * inside the evaluation) is charged to the inner phase only.
+ */
+
+enum perf_phase
+{
+	PERF_IDLE,	  // not searching (waiting, MPI), not reported
+	PERF_SEARCH,  // search overhead not covered by the phases below
+	PERF_MOVEGEN, // legal move generation
+	PERF_MAKE,	  // make_move and restoring the board afterwards
+	PERF_EVAL,	  // evaluation, without the move generation it calls
+	PERF_TT,	  // transposition table probes and stores
+	PERF_NR_PHASES
+};
+
+enum perf_counter
+{
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_CACHE_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_NR_COUNTERS
+};
+
+extern const char *perf_phase_names[PERF_NR_PHASES];
+extern const char *perf_counter_names[PERF_NR_COUNTERS];
+
+#ifdef PERFCTR
+
+void perfctr_init(void);
+int perfctr_switch(int phase);
+void perfctr_finalize(void);
+
+#define PERF_INIT() perfctr_init()
+#define PERF_ENTER(phase) perfctr_switch(phase)
+#define PERF_LEAVE(prev) perfctr_switch(prev)
+#define PERF_FINALIZE() perfctr_finalize()
+
+#else
+
+#define PERF_INIT() ((void)0)
+#define PERF_ENTER(phase) 0
+#define PERF_LEAVE(prev) ((void)(prev))
+#define PERF_FINALIZE() ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,376 @@
+#include <stdlib.h>
+#include "playout.h"
+#include "bitboard.h"
+
+#if BOARD_N <= 8 && defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PLAYOUT_X86 // the AVX2 and AVX-512 kernels
+#endif
+
+#define FILL_STEPS (BOARD_N - 3) // as in bitboard.c
+#define CHUNK 256				 // games a step works on at a time, to stay in the L1 cache
+
+/* a kernel works on the games [from, to), to - from a multiple of PLAYOUT_LANES */
+static void moves_scalar(struct playout_batch *batch, int from, int to);
+static void flips_scalar(struct playout_batch *batch, int from, int to);
+static int choose_loop(struct playout_batch *batch, int from, int to);
+static void (*moves_kernel)(struct playout_batch *batch, int from, int to) = moves_scalar;
+static void (*flips_kernel)(struct playout_batch *batch, int from, int to) = flips_scalar;
+static int (*choose_kernel)(struct playout_batch *batch, int from, int to) = choose_loop;
+static int kernel = PLAYOUT_SCALAR;
+
+const char *playout_kernel_names[PLAYOUT_NR_KERNELS] = {"scalar", "avx2", "avx512"};
+
+static uint64_t next_random(uint64_t *state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+/*
+ * Replaces the moves of every game by a random one of them, 0 for a pass, counts the
+ * passes in a row and hands the move to the other side. Returns the games not over.
+ */
+static int choose_loop(struct playout_batch *batch, int from, int to)
+{
+	bitboard moves;
+	int i, k, running = 0;
+
+	for (i = from; i < to; i++)
+	{
+		moves = batch->move[i];
+		batch->passes[i] = (moves == 0) ? batch->passes[i] + (batch->passes[i] < 2) : 0;
+		k = ((next_random(&batch->random[i]) >> 32) * bb_count(moves)) >> 32;
+		while (k-- > 0)
+			moves &= moves - 1;
+		batch->move[i] = moves & -moves;
+		batch->colour[i] ^= 3;
+		running += (batch->passes[i] < 2);
+	}
+	return running;
+}
+
+static void moves_scalar(struct playout_batch *batch, int from, int to)
+{
+	int i;
+
+	for (i = from; i < to; i++)
+		batch->move[i] = bb_moves(batch->own[i], batch->opp[i]);
+}
+
+static void flips_scalar(struct playout_batch *batch, int from, int to)
+{
+	bitboard own, opp, flips;
+	int i;
+
+	for (i = from; i < to; i++)
+	{
+		own = batch->own[i];
+		opp = batch->opp[i];
+		flips = (batch->move[i] != 0) ? bb_flips(bb_first(batch->move[i]), own, opp) : 0;
+		batch->own[i] = opp & ~flips;
+		batch->opp[i] = own | flips | batch->move[i];
+	}
+}
+
+#ifdef PLAYOUT_X86
+
+/*
+ * The SIMD kernels: a lane is a game. A fill of one direction is shifted by n, to the left
+ * (towards higher bits) or the right, and kept on the squares of mask m; the eight
+ * directions are written out so that every shift is by a constant.
+ */
+
+#define AVX2 __attribute__((target("avx2"), always_inline)) inline
+#define AVX512 __attribute__((target("avx512f"), always_inline)) inline
+
+#define EIGHT_DIRECTIONS(FILL)                                                       \
+	FILL(slli, 1, BB_NOT_FIRST) FILL(srli, 1, BB_NOT_LAST) FILL(slli, 8, BB_REGION)      \
+	FILL(srli, 8, BB_REGION) FILL(slli, 9, BB_NOT_FIRST) FILL(srli, 9, BB_NOT_LAST)      \
+	FILL(slli, 7, BB_NOT_LAST) FILL(srli, 7, BB_NOT_FIRST)
+
+/* the moves of own against opp, and the flips of the moves x (one disc, or none, per lane) */
+#define MOVES4(shift, n, mask)                                                                  \
+	m = _mm256_set1_epi64x(mask);                                                               \
+	through = _mm256_and_si256(opp, m);                                                         \
+	run = _mm256_and_si256(_mm256_##shift##_epi64(own, n), through);                            \
+	for (i = 0; i < FILL_STEPS; i++)                                                            \
+		run = _mm256_or_si256(run, _mm256_and_si256(_mm256_##shift##_epi64(run, n), through)); \
+	moves = _mm256_or_si256(moves, _mm256_and_si256(_mm256_##shift##_epi64(run, n), m));
+
+#define FLIPS4(shift, n, mask)                                                                  \
+	m = _mm256_set1_epi64x(mask);                                                               \
+	through = _mm256_and_si256(opp, m);                                                         \
+	run = _mm256_and_si256(_mm256_##shift##_epi64(x, n), through);                              \
+	for (i = 0; i < FILL_STEPS; i++)                                                            \
+		run = _mm256_or_si256(run, _mm256_and_si256(_mm256_##shift##_epi64(run, n), through)); \
+	end = _mm256_and_si256(_mm256_##shift##_epi64(run, n), _mm256_and_si256(own, m));          \
+	flips = _mm256_or_si256(flips, _mm256_andnot_si256(_mm256_cmpeq_epi64(end, zero), run));
+
+#define MOVES8(shift, n, mask)                                                                  \
+	m = _mm512_set1_epi64(mask);                                                                \
+	through = _mm512_and_si512(opp, m);                                                         \
+	run = _mm512_and_si512(_mm512_##shift##_epi64(own, n), through);                            \
+	for (i = 0; i < FILL_STEPS; i++)                                                            \
+		run = _mm512_or_si512(run, _mm512_and_si512(_mm512_##shift##_epi64(run, n), through)); \
+	moves = _mm512_or_si512(moves, _mm512_and_si512(_mm512_##shift##_epi64(run, n), m));
+
+#define FLIPS8(shift, n, mask)                                                                  \
+	m = _mm512_set1_epi64(mask);                                                                \
+	through = _mm512_and_si512(opp, m);                                                         \
+	run = _mm512_and_si512(_mm512_##shift##_epi64(x, n), through);                              \
+	for (i = 0; i < FILL_STEPS; i++)                                                            \
+		run = _mm512_or_si512(run, _mm512_and_si512(_mm512_##shift##_epi64(run, n), through)); \
+	end = _mm512_and_si512(_mm512_##shift##_epi64(run, n), _mm512_and_si512(own, m));          \
+	flips = _mm512_or_si512(flips, _mm512_maskz_mov_epi64(_mm512_test_epi64_mask(end, end), run));
+
+AVX2 static __m256i moves4(__m256i own, __m256i opp)
+{
+	__m256i moves = _mm256_setzero_si256();
+	__m256i m, through, run;
+	int i;
+
+	EIGHT_DIRECTIONS(MOVES4)
+	return _mm256_andnot_si256(_mm256_or_si256(own, opp), moves);
+}
+
+AVX2 static __m256i flips4(__m256i x, __m256i own, __m256i opp)
+{
+	__m256i flips = _mm256_setzero_si256(), zero = _mm256_setzero_si256();
+	__m256i m, through, run, end;
+	int i;
+
+	EIGHT_DIRECTIONS(FLIPS4)
+	return flips;
+}
+
+AVX512 static __m512i moves8(__m512i own, __m512i opp)
+{
+	__m512i moves = _mm512_setzero_si512();
+	__m512i m, through, run;
+	int i;
+
+	EIGHT_DIRECTIONS(MOVES8)
+	return _mm512_andnot_si512(_mm512_or_si512(own, opp), moves);
+}
+
+AVX512 static __m512i flips8(__m512i x, __m512i own, __m512i opp)
+{
+	__m512i flips = _mm512_setzero_si512();
+	__m512i m, through, run, end;
+	int i;
+
+	EIGHT_DIRECTIONS(FLIPS8)
+	return flips;
+}
+
+#define TARGET(isa) __attribute__((target(isa)))
+
+TARGET("avx2") static void moves_avx2(struct playout_batch *batch, int from, int to)
+{
+	__m256i own, opp;
+	int i;
+
+	for (i = from; i < to; i += 4)
+	{
+		own = _mm256_loadu_si256((const __m256i *)(batch->own + i));
+		opp = _mm256_loadu_si256((const __m256i *)(batch->opp + i));
+		_mm256_storeu_si256((__m256i *)(batch->move + i), moves4(own, opp));
+	}
+}
+
+TARGET("avx2") static void flips_avx2(struct playout_batch *batch, int from, int to)
+{
+	__m256i own, opp, x, flips;
+	int i;
+
+	for (i = from; i < to; i += 4)
+	{
+		own = _mm256_loadu_si256((const __m256i *)(batch->own + i));
+		opp = _mm256_loadu_si256((const __m256i *)(batch->opp + i));
+		x = _mm256_loadu_si256((const __m256i *)(batch->move + i));
+		flips = flips4(x, own, opp);
+		_mm256_storeu_si256((__m256i *)(batch->own + i), _mm256_andnot_si256(flips, opp));
+		_mm256_storeu_si256((__m256i *)(batch->opp + i), _mm256_or_si256(own, _mm256_or_si256(flips, x)));
+	}
+}
+
+TARGET("avx512f") static void moves_avx512(struct playout_batch *batch, int from, int to)
+{
+	int i;
+
+	for (i = from; i < to; i += 8)
+		_mm512_storeu_si512(batch->move + i, moves8(_mm512_loadu_si512(batch->own + i), _mm512_loadu_si512(batch->opp + i)));
+}
+
+TARGET("avx512f") static void flips_avx512(struct playout_batch *batch, int from, int to)
+{
+	__m512i own, opp, x, flips;
+	int i;
+
+	for (i = from; i < to; i += 8)
+	{
+		own = _mm512_loadu_si512(batch->own + i);
+		opp = _mm512_loadu_si512(batch->opp + i);
+		x = _mm512_loadu_si512(batch->move + i);
+		flips = flips8(x, own, opp);
+		_mm512_storeu_si512(batch->own + i, _mm512_andnot_si512(flips, opp));
+		_mm512_storeu_si512(batch->opp + i, _mm512_or_si512(own, _mm512_or_si512(flips, x)));
+	}
+}
+
+/* choose_loop with the k-th move found by PDEP, where it is fast (bitboard.c) */
+TARGET("bmi2") static int choose_pdep(struct playout_batch *batch, int from, int to)
+{
+	bitboard moves;
+	int i, k, running = 0;
+
+	for (i = from; i < to; i++)
+	{
+		moves = batch->move[i];
+		batch->passes[i] = (moves == 0) ? batch->passes[i] + (batch->passes[i] < 2) : 0;
+		k = ((next_random(&batch->random[i]) >> 32) * bb_count(moves)) >> 32;
+		batch->move[i] = _pdep_u64(1ULL << k, moves);
+		batch->colour[i] ^= 3;
+		running += (batch->passes[i] < 2);
+	}
+	return running;
+}
+
+#endif
+
+/* the widest kernel of the cpu */
+void playout_init(void)
+{
+	if (!playout_use(PLAYOUT_AVX512) && !playout_use(PLAYOUT_AVX2))
+		playout_use(PLAYOUT_SCALAR);
+}
+
+/* selects a kernel, 0 if the cpu (or the board size) does not have it */
+int playout_use(int k)
+{
+	if (k == PLAYOUT_SCALAR)
+	{
+		moves_kernel = moves_scalar;
+		flips_kernel = flips_scalar;
+		choose_kernel = choose_loop;
+		kernel = k;
+		return 1;
+	}
+#ifdef PLAYOUT_X86
+	__builtin_cpu_init();
+	if (k == PLAYOUT_AVX2 && __builtin_cpu_supports("avx2"))
+	{
+		moves_kernel = moves_avx2;
+		flips_kernel = flips_avx2;
+	}
+	else if (k == PLAYOUT_AVX512 && __builtin_cpu_supports("avx512f"))
+	{
+		moves_kernel = moves_avx512;
+		flips_kernel = flips_avx512;
+	}
+	else
+		return 0;
+	choose_kernel = (bb_kernel() == BB_BMI2) ? choose_pdep : choose_loop;
+	kernel = k;
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+int playout_kernel(void)
+{
+	return kernel;
+}
+
+/**
+ * Allocates a batch of at least size games, rounded up to PLAYOUT_LANES, all of them over
+ * until they are loaded. Returns the number of games, 0 when out of memory.
+ */
+int playout_batch_init(struct playout_batch *batch, int size, uint64_t seed)
+{
+	int i;
+
+	batch->size = (size + PLAYOUT_LANES - 1) / PLAYOUT_LANES * PLAYOUT_LANES;
+	batch->own = (bitboard *)calloc(batch->size, sizeof(bitboard));
+	batch->opp = (bitboard *)calloc(batch->size, sizeof(bitboard));
+	batch->colour = (int *)calloc(batch->size, sizeof(int));
+	batch->passes = (int *)calloc(batch->size, sizeof(int));
+	batch->random = (uint64_t *)calloc(batch->size, sizeof(uint64_t));
+	batch->move = (bitboard *)calloc(batch->size, sizeof(bitboard));
+	if (batch->own == NULL || batch->opp == NULL || batch->colour == NULL || batch->passes == NULL ||
+		batch->random == NULL || batch->move == NULL)
+	{
+		playout_batch_free(batch);
+		return 0;
+	}
+	for (i = 0; i < batch->size; i++)
+	{
+		batch->colour[i] = 1;
+		batch->passes[i] = 2;
+		batch->random[i] = (seed + (i + 1) * 0x9E3779B97F4A7C15ULL) | 1;
+	}
+	return batch->size;
+}
+
+void playout_batch_free(struct playout_batch *batch)
+{
+	free(batch->own);
+	free(batch->opp);
+	free(batch->colour);
+	free(batch->passes);
+	free(batch->random);
+	free(batch->move);
+	batch->own = batch->opp = batch->move = NULL;
+	batch->colour = batch->passes = NULL;
+	batch->random = NULL;
+	batch->size = 0;
+}
+
+/* game i starts from the mailbox board (board.h) with colour to move */
+void playout_load(struct playout_batch *batch, int i, const int *board, int colour)
+{
+	playout_set(batch, i, bb_get(board, colour), bb_get(board, 3 - colour), colour);
+}
+
+/* game i starts with the discs own of colour to move and opp of the other side */
+void playout_set(struct playout_batch *batch, int i, bitboard own, bitboard opp, int colour)
+{
+	batch->own[i] = own;
+	batch->opp[i] = opp;
+	batch->colour[i] = colour;
+	batch->passes[i] = 0;
+}
+
+/* one move in every game, returns the number of games that are not over */
+int playout_step(struct playout_batch *batch)
+{
+	int from, to, running = 0;
+
+	for (from = 0; from < batch->size; from = to)
+	{
+		to = (batch->size - from < CHUNK) ? batch->size : from + CHUNK;
+		moves_kernel(batch, from, to);
+		running += choose_kernel(batch, from, to);
+		flips_kernel(batch, from, to);
+	}
+	return running;
+}
+
+/* plays every game to the end */
+void playout_run(struct playout_batch *batch)
+{
+	while (playout_step(batch) > 0)
+		;
+}
+
+/* the disc difference of game i from colour's point of view */
+int playout_score(const struct playout_batch *batch, int i, int colour)
+{
+	int diff = bb_count(batch->own[i]) - bb_count(batch->opp[i]);
+
+	return (batch->colour[i] == colour) ? diff : -diff;
+}
@@ -0,0 +1,54 @@
+#ifndef _PLAYOUT_H
+#define _PLAYOUT_H
+
+#include <stdint.h>
+#include "board.h"
+
+/**
+ * Random playouts of many games at once, for rollout heavy work such as Monte Carlo
+ * searches and benchmarks.
+ *
+ * A batch keeps its games as a struct of arrays: the discs of the side to move and of
+ * its opponent (bitboards, see bitboard.h), the colour to move, the passes in a row and
+ * a random generator for every game. playout_step plays one random move, or a pass, in
+ * every game; the legal moves and flips of PLAYOUT_LANES games are computed together,
+ * 4 games per register with AVX2 and 8 with AVX-512. Only the choice of the move is
+ * made game by game. A game stays over once both sides passed.
+ */
+
+#define PLAYOUT_LANES 8 // games per kernel call, the size of a batch is a multiple of it
+
+struct playout_batch
+{
+	int size;
+	bitboard *own;	  // discs of the side to move
+	bitboard *opp;	  // discs of the other side
+	int *colour;	  // side to move, 1 black or 2 white
+	int *passes;	  // passes in a row, 2 ends the game
+	uint64_t *random; // xorshift state of the game
+	bitboard *move;	  // during a step the legal moves, then the move played (0 for a pass)
+};
+
+enum playout_kernel
+{
+	PLAYOUT_SCALAR, // one game at a time, with the move generation of bitboard.h
+	PLAYOUT_AVX2,	// 4 games per register
+	PLAYOUT_AVX512, // 8 games per register
+	PLAYOUT_NR_KERNELS
+};
+
+extern const char *playout_kernel_names[PLAYOUT_NR_KERNELS];
+
+void playout_init(void);
+int playout_use(int kernel);
+int playout_kernel(void);
+
+int playout_batch_init(struct playout_batch *batch, int size, uint64_t seed);
+void playout_batch_free(struct playout_batch *batch);
+void playout_load(struct playout_batch *batch, int i, const int *board, int colour);
+void playout_set(struct playout_batch *batch, int i, bitboard own, bitboard opp, int colour);
+int playout_step(struct playout_batch *batch);
+void playout_run(struct playout_batch *batch);
+int playout_score(const struct playout_batch *batch, int i, int colour);
+
+#endif
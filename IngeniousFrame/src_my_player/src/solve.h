@@ -0,0 +1,123 @@
+/*
+ * Exact endgame search of one side to move, included by my_player.c once for each colour
+ * like negamax.h. The includer defines
+ *   SOLVE          name of the function generated
+ *   SOLVE_OTHER    the function of the other side
+ *   SIDE, OTHER    the colours of the side to move and its opponent
+ *
+ * The score is the final disc difference from SIDE's point of view (final_score), empties is
+ * the number of empty squares and passed is 1 when OTHER passed to reach the board.
+ * Its transposition table entries have depth SOLVE_DEPTH, so no heuristic score is ever
+ * taken for an exact one.
+ * Like negamax.h it calls the bitboard primitives of the two colours directly and keeps the
+ * child moves and the saved board on the stack.
+ */
+
+int SOLVE(int alpha, int beta, int ply, int empties, int passed)
+{
+	int best_score = -SCORE_INF;
+	int child_score;
+	int childMoves[LEGALMOVSBUFSIZE];
+	int original_board[BOARDSIZE];
+	bitboard own, opp, flips, moves;
+	int result;
+	int hit;
+	int perf_prev;
+	int p = min(ply, STATS_MAX_PLY - 1);
+	int alpha0 = alpha;
+	int best_move = -1;
+	int tt_move = -1;
+	int sym;
+	int sq;
+	int i, n;
+	uint64_t key;
+
+	pv_length[p] = 0;
+	stats.nodes++;
+	stats.plies[p].nodes++;
+	if (p > stats.max_depth)
+		stats.max_depth = p;
+
+	perf_prev = PERF_ENTER(PERF_TT);
+	key = tt_hash(board, SIDE, &sym);
+	hit = probe_node(key, SOLVE_DEPTH, alpha, beta, &result, &tt_move);
+	PERF_LEAVE(perf_prev);
+	if (hit)
+		return result;
+	tt_move = sym_loc_inverse(tt_move, sym);
+
+	perf_prev = PERF_ENTER(PERF_MOVEGEN);
+	moves = bb_moves(bb_get(board, SIDE), bb_get(board, OTHER));
+	for (n = 0; moves != 0; moves &= moves - 1)
+		childMoves[++n] = bb_loc(bb_first(moves));
+	childMoves[0] = n;
+	PERF_LEAVE(perf_prev);
+	if (childMoves[0] == 0)
+	{
+		if (passed)
+		{
+			stats.leaf_evals++;
+			return final_score(bb_get(board, SIDE), bb_get(board, OTHER));
+		}
+		return -SOLVE_OTHER(-beta, -alpha, ply + 1, empties, 1);
+	}
+	order_moves(childMoves, tt_move, p);
+	if (empties > SOLVE_SORT_EMPTIES)
+		order_fastest_first(childMoves, bb_get(board, SIDE), bb_get(board, OTHER), (childMoves[1] == tt_move) ? 2 : 1);
+
+	for (i = 1; i <= childMoves[0]; i++)
+	{
+		perf_prev = PERF_ENTER(PERF_MAKE);
+		memcpy(original_board, board, BOARDSIZE * sizeof(int));
+		sq = bb_square(childMoves[i]);
+		own = bb_get(board, SIDE);
+		opp = bb_get(board, OTHER);
+		flips = bb_flips(sq, own, opp);
+		bb_set(board, SIDE, own | flips | ((bitboard)1 << sq));
+		bb_set(board, OTHER, opp & ~flips);
+		board[childMoves[i]] = SIDE;
+		for (; flips != 0; flips &= flips - 1)
+			board[bb_loc(bb_first(flips))] = SIDE;
+		PERF_LEAVE(perf_prev);
+		/* principal variation search like negamax.h */
+		if (i == 1)
+			child_score = -SOLVE_OTHER(-beta, -alpha, ply + 1, empties - 1, 0);
+		else
+		{
+			stats.plies[p].null_window_searches++;
+			child_score = -SOLVE_OTHER(-alpha - 1, -alpha, ply + 1, empties - 1, 0);
+			if (child_score > alpha && child_score < beta)
+			{
+				stats.plies[p].re_searches++;
+				child_score = -SOLVE_OTHER(-beta, -alpha, ply + 1, empties - 1, 0);
+			}
+		}
+		perf_prev = PERF_ENTER(PERF_MAKE);
+		memcpy(board, original_board, BOARDSIZE * sizeof(int));
+		PERF_LEAVE(perf_prev);
+
+		if (i == 1 || child_score > best_score)
+		{
+			update_pv(p, childMoves[i]);
+			best_move = childMoves[i];
+			best_score = child_score;
+		}
+		alpha = max(alpha, child_score);
+		if (beta <= alpha)
+		{
+			stats.cutoffs++;
+			stats.plies[p].cutoffs++;
+			if (i == 1)
+			{
+				stats.first_move_cutoffs++;
+				stats.plies[p].first_move_cutoffs++;
+			}
+			break;
+		}
+	}
+
+	perf_prev = PERF_ENTER(PERF_TT);
+	store_node(key, sym, SOLVE_DEPTH, best_score, alpha0, beta, best_move, tt_move, p);
+	PERF_LEAVE(perf_prev);
+	return best_score;
+}
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "stats.h"
+
+#define NR_COUNTERS 7
+#define COUNTER_MAX_DEPTH 6 // index of max_depth in the gathered counters
+#define NR_TIMERS 2
+
+/* the hardware counters are only gathered and written when they are compiled in */
+#ifdef PERFCTR
+#define NR_PERF (PERF_NR_PHASES * PERF_NR_COUNTERS)
+#else
+#define NR_PERF 0
+#endif
+#define NR_PLY (STATS_MAX_PLY * STATS_NR_PLY_COUNTERS)
+#define NR_GATHERED (NR_COUNTERS + NR_PLY + NR_PERF)
+
+struct search_stats stats;
+
+/* sum of the tree counters of all ranks over all moves of the game, kept at rank 0 */
+static long long game_plies[NR_PLY];
+
+/* nodes of all ranks in the last stats_gather, kept at rank 0 */
+static long long last_total_nodes;
+
+static const char *counter_names[NR_COUNTERS] = {
+	"nodes", "leaf_evals", "tt_probes", "tt_hits", "cutoffs", "first_move_cutoffs", "max_depth"};
+static const char *timer_names[NR_TIMERS] = {"search_time", "mpi_time"};
+
+/**
+ * Clears the counters of this rank, called at the start of every gen_move
+ */
+void stats_reset(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+/* Writes part / whole, or null when there is nothing to compare against */
+static void print_ratio(FILE *fp, const char *name, long long part, long long whole)
+{
+	if (whole > 0)
+		fprintf(fp, ",\"%s\":%.3f", name, (double)part / whole);
+	else
+		fprintf(fp, ",\"%s\":null", name);
+}
+
+/**
+ * Writes the search quality metrics per depth: effective branching factor
+ * (nodes at the next ply per node at this ply), fraction of beta cutoffs on
+ * the first child, PVS re-search rate and TT move hit rate
+ */
+static void print_plies(FILE *fp, const long long *counters)
+{
+	int ply;
+	int first = 1;
+	struct ply_stats plies[STATS_MAX_PLY];
+
+	memcpy(plies, counters, sizeof(plies));
+
+	fprintf(fp, ",\"plies\":[");
+	for (ply = 1; ply < STATS_MAX_PLY && plies[ply].nodes > 0; ply++)
+	{
+		fprintf(fp, "%s{\"ply\":%d,\"nodes\":%lld,\"cutoffs\":%lld",
+				first ? "" : ",", ply, plies[ply].nodes, plies[ply].cutoffs);
+		print_ratio(fp, "ebf", (ply + 1 < STATS_MAX_PLY) ? plies[ply + 1].nodes : 0, plies[ply].nodes);
+		print_ratio(fp, "first_move_cutoff_rate", plies[ply].first_move_cutoffs, plies[ply].cutoffs);
+		print_ratio(fp, "re_search_rate", plies[ply].re_searches, plies[ply].null_window_searches);
+		print_ratio(fp, "tt_move_hit_rate", plies[ply].tt_move_best, plies[ply].tt_moves);
+		fprintf(fp, "}");
+		first = 0;
+	}
+	fprintf(fp, "]");
+}
+
+#ifdef PERFCTR
+/* Writes the hardware counters per phase, skipping the idle phase */
+static void print_perf(FILE *fp, const long long *perf)
+{
+	int phase, counter;
+
+	fprintf(fp, ",\"perf\":{");
+	for (phase = PERF_IDLE + 1; phase < PERF_NR_PHASES; phase++)
+	{
+		fprintf(fp, "%s\"%s\":{", (phase == PERF_IDLE + 1) ? "" : ",", perf_phase_names[phase]);
+		for (counter = 0; counter < PERF_NR_COUNTERS; counter++)
+			fprintf(fp, "%s\"%s\":%lld", (counter == 0) ? "" : ",", perf_counter_names[counter],
+					perf[phase * PERF_NR_COUNTERS + counter]);
+		fprintf(fp, "}");
+	}
+	fprintf(fp, "}");
+}
+#endif
+
+/**
+ * Collective over MPI_COMM_WORLD: gathers the counters of every rank at rank 0,
+ * which writes them as a single JSON record (one line) to fp.
+ * The other ranks may pass fp == NULL and move == NULL.
+ */
+void stats_gather(FILE *fp, int move_nr, int my_colour, const char *move)
+{
+	int rank, nr_of_procs, i, j;
+	long long counters[NR_GATHERED];
+	double timers[NR_TIMERS];
+	long long *all_counters = NULL;
+	double *all_timers = NULL;
+	long long total_counters[NR_GATHERED];
+	double total_timers[NR_TIMERS];
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &nr_of_procs);
+
+	counters[0] = stats.nodes;
+	counters[1] = stats.leaf_evals;
+	counters[2] = stats.tt_probes;
+	counters[3] = stats.tt_hits;
+	counters[4] = stats.cutoffs;
+	counters[5] = stats.first_move_cutoffs;
+	counters[COUNTER_MAX_DEPTH] = stats.max_depth;
+	memcpy(counters + NR_COUNTERS, stats.plies, sizeof(stats.plies));
+#ifdef PERFCTR
+	memcpy(counters + NR_COUNTERS + NR_PLY, stats.perf, sizeof(stats.perf));
+#endif
+	timers[0] = stats.search_time;
+	timers[1] = stats.mpi_time;
+
+	if (rank == 0)
+	{
+		all_counters = (long long *)malloc(nr_of_procs * NR_GATHERED * sizeof(long long));
+		all_timers = (double *)malloc(nr_of_procs * NR_TIMERS * sizeof(double));
+	}
+
+	MPI_Gather(counters, NR_GATHERED, MPI_LONG_LONG, all_counters, NR_GATHERED, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+	MPI_Gather(timers, NR_TIMERS, MPI_DOUBLE, all_timers, NR_TIMERS, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+	if (rank != 0)
+		return;
+
+	memset(total_counters, 0, sizeof(total_counters));
+	memset(total_timers, 0, sizeof(total_timers));
+	for (i = 0; i < nr_of_procs; i++)
+	{
+		for (j = NR_COUNTERS; j < NR_COUNTERS + NR_PLY; j++)
+			game_plies[j - NR_COUNTERS] += all_counters[i * NR_GATHERED + j];
+		for (j = 0; j < NR_GATHERED; j++)
+		{
+			/* max_depth is the deepest ply of any rank, the others add up */
+			if (j == COUNTER_MAX_DEPTH)
+			{
+				if (all_counters[i * NR_GATHERED + j] > total_counters[j])
+					total_counters[j] = all_counters[i * NR_GATHERED + j];
+			}
+			else
+			{
+				total_counters[j] += all_counters[i * NR_GATHERED + j];
+			}
+		}
+		for (j = 0; j < NR_TIMERS; j++)
+			total_timers[j] += all_timers[i * NR_TIMERS + j];
+	}
+	last_total_nodes = total_counters[0];
+
+	if (fp != NULL)
+	{
+
+		fprintf(fp, "{\"move_nr\":%d,\"colour\":%d,\"move\":\"%.2s\",\"procs\":%d,\"ranks\":[",
+				move_nr, my_colour, move, nr_of_procs);
+		for (i = 0; i < nr_of_procs; i++)
+		{
+			fprintf(fp, "%s{\"rank\":%d", (i == 0) ? "" : ",", i);
+			for (j = 0; j < NR_COUNTERS; j++)
+				fprintf(fp, ",\"%s\":%lld", counter_names[j], all_counters[i * NR_GATHERED + j]);
+			for (j = 0; j < NR_TIMERS; j++)
+				fprintf(fp, ",\"%s\":%.6f", timer_names[j], all_timers[i * NR_TIMERS + j]);
+#ifdef PERFCTR
+			print_perf(fp, all_counters + i * NR_GATHERED + NR_COUNTERS + NR_PLY);
+#endif
+			fprintf(fp, "}");
+		}
+		fprintf(fp, "],\"total\":{");
+		for (j = 0; j < NR_COUNTERS; j++)
+			fprintf(fp, "%s\"%s\":%lld", (j == 0) ? "" : ",", counter_names[j], total_counters[j]);
+		for (j = 0; j < NR_TIMERS; j++)
+			fprintf(fp, ",\"%s\":%.6f", timer_names[j], total_timers[j]);
+		print_plies(fp, total_counters + NR_COUNTERS);
+#ifdef PERFCTR
+		print_perf(fp, total_counters + NR_COUNTERS + NR_PLY);
+#endif
+		fprintf(fp, "}}\n");
+		fflush(fp);
+	}
+
+	free(all_counters);
+	free(all_timers);
+}
+
+/**
+ * Rank 0 only: the nodes searched by all ranks, as of the last stats_gather
+ */
+long long stats_total_nodes(void)
+{
+	return last_total_nodes;
+}
+
+/**
+ * Rank 0 only: writes the search quality metrics per depth summed over every move of the game,
+ * if fp is not NULL, and clears them for the next game
+ */
+void stats_game_summary(FILE *fp, int nr_moves)
+{
+	if (fp != NULL)
+	{
+		fprintf(fp, "{\"game_summary\":{\"moves\":%d", nr_moves);
+		print_plies(fp, game_plies);
+		fprintf(fp, "}}\n");
+		fflush(fp);
+	}
+	memset(game_plies, 0, sizeof(game_plies));
+}
@@ -0,0 +1,61 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <stdio.h>
+#include <mpi.h>
+#include "perfctr.h"
+
+#define STATS_MAX_PLY 64
+#define STATS_NR_PLY_COUNTERS 7
+
+/**
+ * Search tree counters of the nodes at a single ply below the root position,
+ * from which the search quality metrics per depth are derived.
+ */
+struct ply_stats
+{
+	long long nodes;				// nodes searched at this ply
+	long long cutoffs;				// beta cutoffs at nodes of this ply
+	long long first_move_cutoffs;	// of which caused by the first child searched
+	long long null_window_searches; // children searched with a null window (PVS)
+	long long re_searches;			// null-window searches repeated with the full window
+	long long tt_moves;				// nodes with a move from the transposition table
+	long long tt_move_best;			// of which the TT move turned out best or caused the cutoff
+};
+
+/**
+ * Per-rank search counters for a single gen_move.
+ * Reset at the start of every gen_move and gathered at rank 0 afterwards.
+ */
+struct search_stats
+{
+	long long nodes;			  // minimax calls
+	long long leaf_evals;		  // calls to the evaluation function
+	long long tt_probes;		  // transposition table lookups
+	long long tt_hits;			  // lookups that returned a usable entry
+	long long cutoffs;			  // beta cutoffs
+	long long first_move_cutoffs; // beta cutoffs caused by the first child
+	long long max_depth;		  // deepest ply reached below the root
+	double search_time;			  // seconds spent inside minimax
+	double mpi_time;			  // seconds blocked in MPI calls
+	struct ply_stats plies[STATS_MAX_PLY];			   // tree counters per ply, plies[1] are the root moves
+	long long perf[PERF_NR_PHASES][PERF_NR_COUNTERS]; // hardware counters per phase, see perfctr.h
+};
+
+extern struct search_stats stats;
+
+/* Time an MPI call and charge it to stats.mpi_time */
+#define STATS_MPI(call)                            \
+	do                                             \
+	{                                              \
+		double _stats_t = MPI_Wtime();             \
+		call;                                      \
+		stats.mpi_time += MPI_Wtime() - _stats_t; \
+	} while (0)
+
+void stats_reset(void);
+void stats_gather(FILE *fp, int move_nr, int my_colour, const char *move);
+void stats_game_summary(FILE *fp, int nr_moves);
+long long stats_total_nodes(void);
+
+#endif
@@ -0,0 +1,191 @@
+#include "symmetry.h"
+#include "bitboard.h"
+
+#if BOARD_N <= 8
+
+/* rows are reversed by reversing the bytes, a smaller board is moved back to the top */
+static bitboard flip_rows(bitboard b)
+{
+	return __builtin_bswap64(b) >> (8 * (8 - BOARD_N));
+}
+
+static bitboard flip_columns(bitboard b)
+{
+	const uint64_t k1 = 0x5555555555555555ULL;
+	const uint64_t k2 = 0x3333333333333333ULL;
+	const uint64_t k4 = 0x0f0f0f0f0f0f0f0fULL;
+
+	b = ((b >> 1) & k1) | ((b & k1) << 1);
+	b = ((b >> 2) & k2) | ((b & k2) << 2);
+	b = ((b >> 4) & k4) | ((b & k4) << 4);
+	return b >> (8 - BOARD_N);
+}
+
+/* swaps row and column with three delta swaps */
+static bitboard transpose(bitboard b)
+{
+	const uint64_t k1 = 0x5500550055005500ULL;
+	const uint64_t k2 = 0x3333000033330000ULL;
+	const uint64_t k4 = 0x0f0f0f0f00000000ULL;
+	uint64_t t;
+
+	t = k4 & (b ^ (b << 28));
+	b ^= t ^ (t >> 28);
+	t = k2 & (b ^ (b << 14));
+	b ^= t ^ (t >> 14);
+	t = k1 & (b ^ (b << 7));
+	b ^= t ^ (t >> 7);
+	return b;
+}
+
+#else
+
+/* the 10x10 board has no word sized tricks, the rows and columns are moved one by one */
+static bitboard flip_rows(bitboard b)
+{
+	const bitboard row = ((bitboard)1 << BOARD_N) - 1;
+	bitboard t = 0;
+	int r;
+
+	for (r = 0; r < BOARD_N; r++)
+		t |= ((b >> (r * BOARD_N)) & row) << ((BOARD_N - 1 - r) * BOARD_N);
+	return t;
+}
+
+static bitboard flip_columns(bitboard b)
+{
+	bitboard column = 0, t = 0;
+	int c;
+
+	for (c = 0; c < BOARD_N; c++)
+		column |= (bitboard)1 << (c * BOARD_N);
+	for (c = 0; c < BOARD_N; c++)
+		t |= ((b >> c) & column) << (BOARD_N - 1 - c);
+	return t;
+}
+
+static bitboard transpose(bitboard b)
+{
+	bitboard t = 0;
+	int r, c;
+
+	for (r = 0; r < BOARD_N; r++)
+	{
+		for (c = 0; c < BOARD_N; c++)
+		{
+			if ((b >> (r * BOARD_N + c)) & 1)
+				t |= (bitboard)1 << (c * BOARD_N + r);
+		}
+	}
+	return t;
+}
+
+#endif
+
+bitboard sym_transform(bitboard b, int s)
+{
+	if (s & 1)
+		b = transpose(b);
+	if (s & 2)
+		b = flip_rows(b);
+	if (s & 4)
+		b = flip_columns(b);
+	return b;
+}
+
+/**
+ * The discs of the board (board.h) as bitboards, black is 1 and white is 2
+ */
+void sym_bitboards(const int *board, bitboard *black, bitboard *white)
+{
+	*black = bb_get(board, 1);
+	*white = bb_get(board, 2);
+}
+
+/**
+ * The mailbox square loc is moved to by symmetry s, -1 (no move) stays -1
+ */
+int sym_loc(int loc, int s)
+{
+	int r = BOARD_ROW(loc), c = BOARD_COL(loc), t;
+
+	if (loc < 0)
+		return loc;
+	if (s & 1)
+	{
+		t = r;
+		r = c;
+		c = t;
+	}
+	if (s & 2)
+		r = BOARD_N - 1 - r;
+	if (s & 4)
+		c = BOARD_N - 1 - c;
+	return BOARD_LOC(r, c);
+}
+
+/**
+ * The mailbox square that symmetry s moves to loc
+ */
+int sym_loc_inverse(int loc, int s)
+{
+	int r = BOARD_ROW(loc), c = BOARD_COL(loc), t;
+
+	if (loc < 0)
+		return loc;
+	if (s & 4)
+		c = BOARD_N - 1 - c;
+	if (s & 2)
+		r = BOARD_N - 1 - r;
+	if (s & 1)
+	{
+		t = r;
+		r = c;
+		c = t;
+	}
+	return BOARD_LOC(r, c);
+}
+
+/**
+ * The symmetries that leave the board as it is, bit s for symmetry s
+ */
+int sym_stabiliser(const int *board)
+{
+	bitboard black, white;
+	int s, mask = 1;
+
+	sym_bitboards(board, &black, &white);
+	for (s = 1; s < SYM_COUNT; s++)
+	{
+		if (sym_transform(black, s) == black && sym_transform(white, s) == white)
+			mask |= 1 << s;
+	}
+	return mask;
+}
+
+/**
+ * Removes the moves (moves[0] is their number) that a symmetry of the board maps to an
+ * earlier move, they lead to the same position turned around. Returns the number removed.
+ */
+int sym_unique_moves(const int *board, int *moves)
+{
+	int mask = sym_stabiliser(board);
+	int i, j, s, n = 0, duplicate;
+
+	if (mask == 1)
+		return 0;
+	for (i = 1; i <= moves[0]; i++)
+	{
+		duplicate = 0;
+		for (j = 1; j <= n && !duplicate; j++)
+		{
+			for (s = 1; s < SYM_COUNT && !duplicate; s++)
+				duplicate = ((mask >> s) & 1) && sym_loc(moves[j], s) == moves[i];
+		}
+		if (!duplicate)
+			moves[++n] = moves[i];
+	}
+	i = moves[0] - n;
+	moves[0] = n;
+	return i;
+}
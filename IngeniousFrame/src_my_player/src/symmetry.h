@@ -0,0 +1,22 @@
+#ifndef _SYMMETRY_H
+#define _SYMMETRY_H
+
+#include <stdint.h>
+#include "board.h"
+
+/**
+ * The 8 symmetries of the board, on bitboards (board.h). Symmetry s transposes the board
+ * if s & 1, then flips the rows if s & 2 and then the columns if s & 4; symmetry 0 is the
+ * identity.
+ */
+
+#define SYM_COUNT 8
+
+bitboard sym_transform(bitboard b, int s);
+void sym_bitboards(const int *board, bitboard *black, bitboard *white);
+int sym_loc(int loc, int s);
+int sym_loc_inverse(int loc, int s);
+int sym_stabiliser(const int *board);
+int sym_unique_moves(const int *board, int *moves);
+
+#endif
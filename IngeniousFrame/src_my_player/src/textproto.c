@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <poll.h>
+#include <unistd.h>
+#include "comms.h"
+#include "textproto.h"
+
+#define INBUFSIZE 65536
+
+static char inbuf[INBUFSIZE];
+static int inlen;
+static int eof;
+
+/* Appends what stdin has to the buffer, waiting for input only if wait is set */
+static void fill(int wait)
+{
+	struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+	ssize_t n;
+
+	if (eof || inlen == INBUFSIZE)
+		return;
+	if (!wait && poll(&pfd, 1, 0) <= 0)
+		return;
+	n = read(STDIN_FILENO, inbuf + inlen, INBUFSIZE - inlen);
+	if (n <= 0)
+		eof = 1;
+	else
+		inlen += n;
+}
+
+/* Copies the line inbuf[start, end) without its line ending to line and removes it, with the newline at end, from the buffer */
+static void take_line(char *line, int size, int start, int end)
+{
+	int len = end - start;
+	int next = (end < inlen) ? end + 1 : end;
+
+	while (len > 0 && (inbuf[start + len - 1] == '\r' || inbuf[start + len - 1] == ' '))
+		len--;
+	if (line != NULL)
+	{
+		if (len >= size)
+			len = size - 1;
+		memcpy(line, inbuf + start, len);
+		line[len] = '\0';
+	}
+	memmove(inbuf + start, inbuf + next, inlen - next);
+	inlen -= next - start;
+}
+
+/**
+ * Reads the next line from stdin, blocking until it is complete.
+ * Returns FAILURE at the end of the input.
+ */
+int text_get_line(char *line, int size)
+{
+	char *nl;
+
+	for (;;)
+	{
+		nl = memchr(inbuf, '\n', inlen);
+		if (nl != NULL)
+		{
+			take_line(line, size, 0, nl - inbuf);
+			return SUCCESS;
+		}
+		/* a line longer than the buffer, or the last line without a newline */
+		if ((eof && inlen > 0) || inlen == INBUFSIZE)
+		{
+			take_line(line, size, 0, inlen);
+			return SUCCESS;
+		}
+		if (eof)
+			return FAILURE;
+		fill(1);
+	}
+}
+
+/**
+ * Returns 1 if a stop command arrived, which is then removed from the input.
+ * Never blocks; other commands stay buffered until text_get_line.
+ */
+int text_poll_stop(void)
+{
+	int start = 0;
+	char *nl;
+
+	fill(0);
+	while ((nl = memchr(inbuf + start, '\n', inlen - start)) != NULL)
+	{
+		if (strncmp(inbuf + start, "stop", 4) == 0 && strspn(inbuf + start + 4, " \r") == (size_t)(nl - inbuf - start - 4))
+		{
+			take_line(NULL, 0, start, nl - inbuf);
+			return 1;
+		}
+		start = nl - inbuf + 1;
+	}
+	return 0;
+}
+
+/**
+ * Writes a reply to stdout, flushed at once because the driver waits for it
+ */
+void text_send(const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+	fflush(stdout);
+}
@@ -0,0 +1,17 @@
+#ifndef _TEXTPROTO_H
+#define _TEXTPROTO_H
+
+/**
+ * Line based text protocol on stdin/stdout, used by rank 0 in stdio mode
+ * (my_player --stdio). Input is read with read(2) into a buffer of its own,
+ * so a running search can poll for a stop command without blocking and
+ * without losing the commands that follow it.
+ */
+
+#define TEXT_LINESIZE 4096
+
+int text_get_line(char *line, int size);
+int text_poll_stop(void);
+void text_send(const char *format, ...);
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include "trace.h"
+
+#ifdef TRACE
+
+#define TRACE_BUFSIZE 65536 // events per rank, later events are dropped
+
+struct trace_record
+{
+	double ts;	// seconds since trace_init
+	int event;	// enum trace_event
+	int phase;	// 'B' or 'E'
+	int arg;	// event specific, -1 if unused
+	int unused; // keeps the record a multiple of 8 bytes
+};
+
+static const char *event_names[TRACE_NR_EVENTS] = {
+	"comms_wait", "comms_send", "bcast", "minimax", "gather", "idle", "log", "mcts"};
+
+static struct trace_record *records;
+static int nr_records;
+static int nr_dropped;
+static double trace_start;
+
+/**
+ * Collective: allocates the event buffer and synchronises the time origin of all ranks
+ */
+void trace_init(void)
+{
+	records = (struct trace_record *)malloc(TRACE_BUFSIZE * sizeof(struct trace_record));
+	nr_records = 0;
+	nr_dropped = 0;
+	MPI_Barrier(MPI_COMM_WORLD);
+	trace_start = MPI_Wtime();
+}
+
+static void trace_record(enum trace_event event, int phase, int arg)
+{
+	if (nr_records == TRACE_BUFSIZE)
+	{
+		nr_dropped++;
+		return;
+	}
+	records[nr_records].ts = MPI_Wtime() - trace_start;
+	records[nr_records].event = event;
+	records[nr_records].phase = phase;
+	records[nr_records].arg = arg;
+	records[nr_records].unused = 0;
+	nr_records++;
+}
+
+void trace_begin(enum trace_event event, int arg)
+{
+	trace_record(event, 'B', arg);
+}
+
+void trace_end(enum trace_event event)
+{
+	trace_record(event, 'E', -1);
+}
+
+/**
+ * Collective: gathers the events of every rank at rank 0, which writes them to filename.
+ * Each rank shows up as its own process in the trace viewer.
+ */
+void trace_finalize(const char *filename)
+{
+	int rank, nr_of_procs, i, total;
+	int my_bytes = nr_records * sizeof(struct trace_record);
+	int *bytes = NULL;
+	int *displs = NULL;
+	int *dropped = NULL;
+	struct trace_record *all_records = NULL;
+	struct trace_record *r;
+	FILE *fp;
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &nr_of_procs);
+
+	if (rank == 0)
+	{
+		bytes = (int *)malloc(nr_of_procs * sizeof(int));
+		displs = (int *)malloc(nr_of_procs * sizeof(int));
+		dropped = (int *)malloc(nr_of_procs * sizeof(int));
+	}
+	MPI_Gather(&my_bytes, 1, MPI_INT, bytes, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Gather(&nr_dropped, 1, MPI_INT, dropped, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+	if (rank == 0)
+	{
+		total = 0;
+		for (i = 0; i < nr_of_procs; i++)
+		{
+			displs[i] = total;
+			total += bytes[i];
+		}
+		all_records = (struct trace_record *)malloc(total + 1);
+	}
+	MPI_Gatherv(records, my_bytes, MPI_BYTE, all_records, bytes, displs, MPI_BYTE, 0, MPI_COMM_WORLD);
+
+	if (rank == 0 && filename != NULL && (fp = fopen(filename, "w")) != NULL)
+	{
+		fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		for (i = 0; i < nr_of_procs; i++)
+		{
+			fprintf(fp, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,"
+						"\"args\":{\"name\":\"rank %d (%d events dropped)\"}}",
+					(i == 0) ? "" : ",\n", i, i, dropped[i]);
+		}
+		for (i = 0; i < nr_of_procs; i++)
+		{
+			for (r = all_records + displs[i] / sizeof(struct trace_record);
+				 r < all_records + (displs[i] + bytes[i]) / sizeof(struct trace_record); r++)
+			{
+				fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":0",
+						event_names[r->event], r->phase, r->ts * 1e6, i);
+				if (r->arg != -1)
+					fprintf(fp, ",\"args\":{\"move\":%d}", r->arg);
+				fprintf(fp, "}");
+			}
+		}
+		fprintf(fp, "\n]}\n");
+		fclose(fp);
+	}
+
+	free(bytes);
+	free(displs);
+	free(dropped);
+	free(all_records);
+	free(records);
+}
+
+#endif
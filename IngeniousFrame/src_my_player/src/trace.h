@@ -0,0 +1,44 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/**
+ * Timeline tracing of the engine, written as Chrome/Perfetto trace-event JSON.
+ * Only compiled in when TRACE is defined (make TRACE=1), otherwise every
+ * TRACE_* macro expands to nothing.
+ */
+
+enum trace_event
+{
+	TRACE_COMMS_WAIT, // rank 0 waiting for the referee in comms_get_cmd
+	TRACE_COMMS_SEND, // rank 0 sending its move to the referee
+	TRACE_BCAST,	  // board / running broadcasts
+	TRACE_MINIMAX,	  // search of a single root move, arg is the move
+	TRACE_GATHER,	  // gathering the root results and the search statistics
+	TRACE_IDLE,		  // worker ranks waiting for the next gen_move
+	TRACE_LOG,		  // writing the board to the log file
+	TRACE_MCTS,		  // Monte Carlo search of the rank, merges of the root moves included
+	TRACE_NR_EVENTS
+};
+
+#ifdef TRACE
+
+void trace_init(void);
+void trace_begin(enum trace_event event, int arg);
+void trace_end(enum trace_event event);
+void trace_finalize(const char *filename);
+
+#define TRACE_INIT() trace_init()
+#define TRACE_BEGIN(event, arg) trace_begin(event, arg)
+#define TRACE_END(event) trace_end(event)
+#define TRACE_FINALIZE(filename) trace_finalize(filename)
+
+#else
+
+#define TRACE_INIT() ((void)0)
+#define TRACE_BEGIN(event, arg) ((void)0)
+#define TRACE_END(event) ((void)0)
+#define TRACE_FINALIZE(filename) ((void)0)
+
+#endif
+
+#endif
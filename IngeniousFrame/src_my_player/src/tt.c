@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tt.h"
+#include "symmetry.h"
+
+#define TT_SIZE (1 << TT_BITS)
+
+static struct tt_entry *table;
+
+/* finaliser of splitmix64, a bijection that mixes all bits */
+static uint64_t mix(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* a bitboard in one word, the 10x10 board's high word is mixed into the low one */
+static uint64_t fold(bitboard b)
+{
+#if BOARD_N <= 8
+	return b;
+#else
+	return (uint64_t)b ^ mix((uint64_t)(b >> 64) ^ 0x0a0a0a0a0a0a0a0aULL);
+#endif
+}
+
+static uint64_t hash_bitboards(bitboard black, bitboard white, int colour)
+{
+	return mix(fold(black) + mix(fold(white) ^ 0x4f7468656c6c6f21ULL)) ^ ((colour == 2) ? 0x9e3779b97f4a7c15ULL : 0);
+}
+
+void tt_init(void)
+{
+	table = (struct tt_entry *)calloc(TT_SIZE, sizeof(struct tt_entry));
+}
+
+void tt_free(void)
+{
+	free(table);
+	table = NULL;
+}
+
+/**
+ * Key of the position on board with colour (1 black, 2 white) to move, the same for all
+ * 8 symmetric positions: the smallest hash of the turned boards. *sym is the symmetry
+ * (symmetry.h) that turns the board into the one hashed, the moves of an entry are
+ * turned the same way (sym_loc to store one, sym_loc_inverse to play one).
+ */
+uint64_t tt_hash(const int *board, int colour, int *sym)
+{
+	bitboard black, white;
+	uint64_t h, key;
+	int s;
+
+	sym_bitboards(board, &black, &white);
+	key = hash_bitboards(black, white, colour);
+	*sym = 0;
+	for (s = 1; s < SYM_COUNT; s++)
+	{
+		h = hash_bitboards(sym_transform(black, s), sym_transform(white, s), colour);
+		if (h < key)
+		{
+			key = h;
+			*sym = s;
+		}
+	}
+	return key;
+}
+
+/**
+ * The entry of the position with this key, NULL if the table holds another position
+ */
+struct tt_entry *tt_probe(uint64_t key)
+{
+	struct tt_entry *e = &table[key & (TT_SIZE - 1)];
+
+	return (e->flag != TT_EMPTY && e->key == key) ? e : NULL;
+}
+
+/**
+ * Stores a search result; an entry of the same position is only replaced by an
+ * equally deep or deeper one, another position is always replaced
+ */
+void tt_store(uint64_t key, int depth, int score, int flag, int move)
+{
+	struct tt_entry *e = &table[key & (TT_SIZE - 1)];
+
+	if (e->flag != TT_EMPTY && e->key == key && depth < e->depth)
+		return;
+	e->key = key;
+	e->score = score;
+	e->depth = depth;
+	e->flag = flag;
+	e->move = move;
+}
+
+/**
+ * Copies the entries searched at least min_depth deep to a new array in *entries,
+ * which the caller frees. Returns their number.
+ */
+int tt_collect(int min_depth, struct tt_entry **entries)
+{
+	int i, n = 0;
+
+	for (i = 0; i < TT_SIZE; i++)
+	{
+		if (table[i].flag != TT_EMPTY && table[i].depth >= min_depth)
+			n++;
+	}
+	*entries = (struct tt_entry *)malloc((n + 1) * sizeof(struct tt_entry));
+	n = 0;
+	for (i = 0; i < TT_SIZE; i++)
+	{
+		if (table[i].flag != TT_EMPTY && table[i].depth >= min_depth)
+			(*entries)[n++] = table[i];
+	}
+	return n;
+}
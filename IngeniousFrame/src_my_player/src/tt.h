@@ -0,0 +1,43 @@
+#ifndef _TT_H
+#define _TT_H
+
+#include <stdint.h>
+
+/**
+ * Transposition table of one rank, kept over all searches of a run.
+ *
+ * Positions are identified by a hash of the board and the side to move (tt_hash), which
+ * is the same for the 8 symmetric boards, so a position turned around shares its entry.
+ * Scores are stored from the point of view of the side to move, so an entry is valid
+ * whichever colour the engine plays. The keys are the same in every run, which lets
+ * entries be saved to the experience file (experience.h) and the book (book.h).
+ */
+
+#define TT_BITS 20	   // 2^20 entries of 16 bytes per rank
+
+/* what the score of an entry is */
+enum tt_flag
+{
+	TT_EMPTY,
+	TT_EXACT,
+	TT_LOWER, // the score is at least this (the search failed high)
+	TT_UPPER  // the score is at most this (the search failed low)
+};
+
+struct tt_entry
+{
+	uint64_t key;
+	int32_t score;
+	int8_t depth; // remaining depth of the search below the position
+	int8_t flag;  // see tt_flag
+	int16_t move; // best move as a mailbox square of the turned board, -1 for none
+};
+
+void tt_init(void);
+void tt_free(void);
+uint64_t tt_hash(const int *board, int colour, int *sym);
+struct tt_entry *tt_probe(uint64_t key);
+void tt_store(uint64_t key, int depth, int score, int flag, int move);
+int tt_collect(int min_depth, struct tt_entry **entries);
+
+#endif
@@ -42,15 +42,23 @@
 #include <assert.h>
 #include "comms.h"
 
+/* squares per side, make BOARD_N=6 (or 10) builds the player for that board size */
+#ifndef BOARD_N
+#define BOARD_N 8
+#endif
+#define WIDTH (BOARD_N + 2) /* a row of the board with its border */
+#define FIRST (WIDTH + 1)
+#define LAST (BOARD_N * WIDTH + BOARD_N)
+
 const int EMPTY = 0;
 const int BLACK = 1;
 const int WHITE = 2;
 
 const int OUTER = 3;
-const int ALLDIRECTIONS[8] = {-11, -10, -9, -1, 1, 9, 10, 11};
-const int BOARDSIZE = 100;
+const int ALLDIRECTIONS[8] = {-WIDTH - 1, -WIDTH, -WIDTH + 1, -1, 1, WIDTH - 1, WIDTH, WIDTH + 1};
+const int BOARDSIZE = WIDTH * WIDTH;
 
-const int LEGALMOVSBUFSIZE = 65;
+const int LEGALMOVSBUFSIZE = BOARD_N * BOARD_N + 1;
 const char piecenames[4] = {'.','b','w','?'};
 
 void run_master(int argc, char *argv[]);
@@ -181,14 +189,12 @@ int initialise_master(int argc, char *argv[], int *time_limit, int *my_colour, F
 }
 
 void initialise_board() {
-	int i;
+	int i, mid = WIDTH * (BOARD_N / 2) + BOARD_N / 2; /* the top left square of the centre */
 	board = (int *) malloc(BOARDSIZE * sizeof(int));
-	for (i = 0; i <= 9; i++) board[i] = OUTER;
-	for (i = 10; i <= 89; i++) {
-		if (i%10 >= 1 && i%10 <= 8) board[i] = EMPTY; else board[i] = OUTER;
+	for (i = 0; i < BOARDSIZE; i++) {
+		if (validp(i)) board[i] = EMPTY; else board[i] = OUTER;
 	}
-	for (i = 90; i <= 99; i++) board[i] = OUTER;
-	board[44] = WHITE; board[45] = BLACK; board[54] = BLACK; board[55] = WHITE;
+	board[mid] = WHITE; board[mid + 1] = BLACK; board[mid + WIDTH] = BLACK; board[mid + WIDTH + 1] = WHITE;
 }
 
 void free_board() {
@@ -254,10 +260,9 @@ void game_over() {
 }
 
 void get_move_string(int loc, char *ms) {
-	int row, col, new_loc;
-	new_loc = loc - (9 + 2 * (loc / 10));
-	row = new_loc / 8;
-	col = new_loc % 8;
+	int row, col;
+	row = loc / WIDTH - 1;
+	col = loc % WIDTH - 1;
 	ms[0] = row + '0';
 	ms[1] = col + '0';
 	ms[2] = '\n';
@@ -269,14 +274,14 @@ int get_loc(char* movestring) {
 	/* movestring of form "xy", x = row and y = column */ 
 	row = movestring[0] - '0'; 
 	col = movestring[1] - '0'; 
-	return (10 * (row + 1)) + col + 1;
+	return (WIDTH * (row + 1)) + col + 1;
 }
 
 void legal_moves(int player, int *moves, FILE *fp) {
 	int move, i;
 	moves[0] = 0;
 	i = 0;
-	for (move = 11; move <= 88; move++) {
+	for (move = FIRST; move <= LAST; move++) {
 		if (legalp(move, player, fp)) {
       i++;
       moves[i] = move;
@@ -297,7 +302,7 @@ int legalp(int move, int player, FILE *fp) {
 }
 
 int validp(int move) {
-	if ((move >= 11) && (move <= 88) && (move%10 >= 1) && (move%10 <= 8))
+	if ((move >= FIRST) && (move <= LAST) && (move%WIDTH >= 1) && (move%WIDTH <= BOARD_N))
 		return 1;
 	else return 0;
 }
@@ -356,12 +361,14 @@ void make_flips(int move, int dir, int player, FILE *fp) {
 
 void print_board(FILE *fp) {
 	int row, col;
-	fprintf(fp, "   1 2 3 4 5 6 7 8 [%c=%d %c=%d]\n",
+	fprintf(fp, "  ");
+	for (col = 1; col <= BOARD_N; col++) fprintf(fp, "%2d", col);
+	fprintf(fp, " [%c=%d %c=%d]\n",
 		nameof(BLACK), count(BLACK, board), nameof(WHITE), count(WHITE, board));
-	for (row = 1; row <= 8; row++) {
-		fprintf(fp, "%d  ", row);
-		for (col = 1; col <= 8; col++)
-			fprintf(fp, "%c ", nameof(board[col + (10 * row)]));
+	for (row = 1; row <= BOARD_N; row++) {
+		fprintf(fp, "%-3d", row);
+		for (col = 1; col <= BOARD_N; col++)
+			fprintf(fp, "%c ", nameof(board[col + (WIDTH * row)]));
 		fprintf(fp, "\n");
 	}
 	fflush(fp);
@@ -375,7 +382,7 @@ char nameof(int piece) {
 int count(int player, int * board) {
 	int i, cnt;
 	cnt = 0;
-	for (i = 1; i <= 88; i++)
+	for (i = FIRST; i <= LAST; i++)
 		if (board[i] == player) cnt++;
 	return cnt;
 }
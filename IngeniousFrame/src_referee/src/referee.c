@@ -0,0 +1,726 @@
+/* vim: :se ai :se sw=4 :se ts=4 :se sts :se et */
+
+/*H**********************************************************************
+ *
+ *    Native referee for Othello engines that use comms.h, to play matches
+ *    without the Java IngeniousFramework.
+ *
+ *    The referee listens on one port per colour, starts both players (with
+ *    mpirun when they run on more than one process) and speaks the protocol
+ *    comms_get_cmd/comms_send_move expect:
+ *        - on connect the player receives its colour as a single character,
+ *          '1' for black and '2' for white
+ *        - every command is a two digit length followed by the command,
+ *          "gen_move", "play_move <rc>" or "game_over"
+ *        - the player answers gen_move with "<rc>\n" or "pass\n",
+ *          where r and c are the row and column starting at 0
+ *    A player that has no legal move is skipped, the game ends when neither
+ *    player can move. A player that exceeds the time limit, plays an illegal
+ *    move or disconnects loses the game.
+ *
+ *    A daemon player is started once as "<player> --daemon <ip> <port> <time_limit> <logfile>"
+ *    and keeps its MPI job for all games: after game_over it connects to its port again
+ *    and is given the colour of the next game. It exits when the connection is refused,
+ *    after the referee closed its ports. A daemon that died is started again.
+ *
+ *    Usage: referee [options] <player1> <player2>
+ *        -g <games>     games to play, player1 is black in the even games (1)
+ *        -t <seconds>   time limit per move given to the players (4)
+ *        -G <seconds>   grace period on top of the time limit (0.5)
+ *        -n <procs>     MPI processes per player, 1 runs the player directly (4)
+ *        -m <command>   MPI launcher, e.g. "mpirun --oversubscribe" (mpirun)
+ *        -s <size>      board size, 6, 8 or 10 (8)
+ *        -l <dir>       directory for the log files of the players (.)
+ *        -o <file>      append the result of every game as a JSON line
+ *        -c <cpus>      run the players on these cpus only, e.g. "0-3" or "4,5,6,7"
+ *        -d <players>   start these players once with --daemon, e.g. "1" or "12", they
+ *                       connect again after every game_over (see below)
+ *        -v             show the output of the players
+ *
+ *H***********************************************************************/
+
+#define _GNU_SOURCE // sched_setaffinity
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define FAILURE -1
+#define SUCCESS 0
+
+#define MAXSIZE 10
+#define MAXSQUARES ((MAXSIZE + 2) * (MAXSIZE + 2))
+#define MAXMOVES (MAXSIZE * MAXSIZE * 2)
+#define MOVEBUFSIZE 6
+#define CMDBUFSIZE 100
+#define MAXARGS 64
+
+const int EMPTY = 0;
+const int BLACK = 1;
+const int WHITE = 2;
+const int OUTER = 3;
+
+const double CONNECT_TIMEOUT = 60.0; // seconds a player may take to start and connect
+const double EXIT_TIMEOUT = 5.0;	 // seconds a player may take to exit after game_over
+
+struct options
+{
+	int games;
+	int time_limit;
+	double grace;
+	int procs;
+	const char *mpirun;
+	int size;
+	const char *logdir;
+	const char *results;
+	const char *cpus;
+	const char *daemons;
+	int verbose;
+};
+
+struct player
+{
+	const char *path;
+	const char *name;
+	int daemon; // started once for all games
+	pid_t pid;
+	int listen_fd;
+	int port;
+	int fd;
+	double time_used;
+	char logfile[256];
+};
+
+struct game_result
+{
+	int winner; // BLACK, WHITE or EMPTY for a draw
+	const char *reason;
+	int discs[3];
+	int nr_moves;
+	char moves[MAXMOVES][MOVEBUFSIZE];
+};
+
+int size;  // squares per side
+int width; // width of the padded mailbox board
+int board[MAXSQUARES];
+int directions[8];
+
+void usage(void);
+int parse_options(int argc, char *argv[], struct options *opts);
+int set_cpus(const char *cpus);
+double now(void);
+void initialise_board(void);
+int opponent(int player);
+int square(int row, int col);
+int would_flip(int move, int dir, int player);
+int legalp(int move, int player);
+int any_legal(int player);
+void make_move(int move, int player);
+int count(int player);
+int parse_move(const char *move);
+int open_listener(int *port);
+pid_t spawn_player(struct player *p, const struct options *opts);
+int running(struct player *p);
+int accept_player(struct player *p, double timeout);
+int send_cmd(int fd, const char *cmd);
+int recv_move(int fd, char *move, double timeout);
+void stop_player(struct player *p, double timeout);
+void play_game(struct player *players[3], const struct options *opts, struct game_result *result);
+void write_result(FILE *fp, struct player *players[3], int game, const struct game_result *result);
+
+int main(int argc, char *argv[])
+{
+	struct options opts;
+	struct player p1, p2;
+	struct player *players[3];
+	struct game_result *result = (struct game_result *)malloc(sizeof(struct game_result));
+	FILE *fp = NULL;
+	int arg, game;
+	double score = 0.0;
+
+	arg = parse_options(argc, argv, &opts);
+	if (arg == FAILURE || argc - arg != 2)
+	{
+		usage();
+		return 1;
+	}
+
+	/* the players inherit the affinity, so matches on disjoint cpu sets do not compete */
+	if (opts.cpus != NULL && set_cpus(opts.cpus) == FAILURE)
+	{
+		fprintf(stderr, "referee: invalid cpu list %s\n", opts.cpus);
+		return 1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	memset(&p1, 0, sizeof(p1));
+	memset(&p2, 0, sizeof(p2));
+	p1.path = argv[arg];
+	p2.path = argv[arg + 1];
+	p1.name = "player1";
+	p2.name = "player2";
+	p1.daemon = (opts.daemons != NULL && strchr(opts.daemons, '1') != NULL);
+	p2.daemon = (opts.daemons != NULL && strchr(opts.daemons, '2') != NULL);
+	p1.listen_fd = open_listener(&p1.port);
+	p2.listen_fd = open_listener(&p2.port);
+	if (p1.listen_fd == FAILURE || p2.listen_fd == FAILURE)
+	{
+		perror("referee: could not open listening socket");
+		return 1;
+	}
+
+	if (opts.results != NULL && (fp = fopen(opts.results, "a")) == NULL)
+	{
+		perror(opts.results);
+		return 1;
+	}
+
+	for (game = 0; game < opts.games; game++)
+	{
+		players[EMPTY] = NULL;
+		players[BLACK] = (game % 2 == 0) ? &p1 : &p2;
+		players[WHITE] = (game % 2 == 0) ? &p2 : &p1;
+
+		play_game(players, &opts, result);
+		write_result(stdout, players, game, result);
+		if (fp != NULL)
+			write_result(fp, players, game, result);
+
+		if (result->winner == EMPTY)
+			score += 0.5;
+		else if (players[result->winner] == &p1)
+			score += 1.0;
+	}
+	/* a daemon exits when it cannot connect any more */
+	close(p1.listen_fd);
+	close(p2.listen_fd);
+	stop_player(&p1, EXIT_TIMEOUT);
+	stop_player(&p2, EXIT_TIMEOUT);
+
+	if (opts.games > 1)
+		printf("# %s %.1f - %.1f %s\n", p1.path, score, opts.games - score, p2.path);
+
+	if (fp != NULL)
+		fclose(fp);
+	free(result);
+	return 0;
+}
+
+void usage(void)
+{
+	fprintf(stderr, "Usage: referee [-g games] [-t time_limit] [-G grace] [-n procs] [-m mpirun]\n"
+					"               [-s size] [-l logdir] [-o results] [-c cpus] [-d players] [-v]\n"
+					"               <player1> <player2>\n");
+}
+
+/**
+ * Fills opts from the command line, returns the index of the first player or FAILURE
+ */
+int parse_options(int argc, char *argv[], struct options *opts)
+{
+	int c;
+
+	opts->games = 1;
+	opts->time_limit = 4;
+	opts->grace = 0.5;
+	opts->procs = 4;
+	opts->mpirun = "mpirun";
+	opts->size = 8;
+	opts->logdir = ".";
+	opts->results = NULL;
+	opts->cpus = NULL;
+	opts->daemons = NULL;
+	opts->verbose = 0;
+
+	while ((c = getopt(argc, argv, "g:t:G:n:m:s:l:o:c:d:v")) != -1)
+	{
+		switch (c)
+		{
+		case 'g':
+			opts->games = atoi(optarg);
+			break;
+		case 't':
+			opts->time_limit = atoi(optarg);
+			break;
+		case 'G':
+			opts->grace = atof(optarg);
+			break;
+		case 'n':
+			opts->procs = atoi(optarg);
+			break;
+		case 'm':
+			opts->mpirun = optarg;
+			break;
+		case 's':
+			opts->size = atoi(optarg);
+			break;
+		case 'l':
+			opts->logdir = optarg;
+			break;
+		case 'o':
+			opts->results = optarg;
+			break;
+		case 'c':
+			opts->cpus = optarg;
+			break;
+		case 'd':
+			opts->daemons = optarg;
+			break;
+		case 'v':
+			opts->verbose = 1;
+			break;
+		default:
+			return FAILURE;
+		}
+	}
+	if (opts->games < 1 || opts->time_limit < 1 || opts->procs < 1 ||
+		opts->size < 4 || opts->size > MAXSIZE || opts->size % 2 != 0)
+		return FAILURE;
+	return optind;
+}
+
+/**
+ * Restricts this process, and the players it starts, to a cpu list like "0-3,8"
+ */
+int set_cpus(const char *cpus)
+{
+	cpu_set_t set;
+	char *list = strdup(cpus);
+	char *tok, *dash;
+	int first, last, cpu;
+	int result = SUCCESS;
+
+	CPU_ZERO(&set);
+	for (tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ","))
+	{
+		first = atoi(tok);
+		dash = strchr(tok, '-');
+		last = (dash != NULL) ? atoi(dash + 1) : first;
+		if (first < 0 || last < first || last >= CPU_SETSIZE)
+			result = FAILURE;
+		for (cpu = first; cpu <= last && result == SUCCESS; cpu++)
+			CPU_SET(cpu, &set);
+	}
+	free(list);
+	if (result == SUCCESS && CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0)
+		return SUCCESS;
+	return FAILURE;
+}
+
+double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/////////////////////////////////////////////////////////////////// rules
+
+void initialise_board(void)
+{
+	int i, row, col;
+	int mid = size / 2;
+
+	width = size + 2;
+	directions[0] = -width - 1;
+	directions[1] = -width;
+	directions[2] = -width + 1;
+	directions[3] = -1;
+	directions[4] = 1;
+	directions[5] = width - 1;
+	directions[6] = width;
+	directions[7] = width + 1;
+
+	for (i = 0; i < width * width; i++)
+		board[i] = OUTER;
+	for (row = 0; row < size; row++)
+		for (col = 0; col < size; col++)
+			board[square(row, col)] = EMPTY;
+	board[square(mid - 1, mid - 1)] = WHITE;
+	board[square(mid - 1, mid)] = BLACK;
+	board[square(mid, mid - 1)] = BLACK;
+	board[square(mid, mid)] = WHITE;
+}
+
+int opponent(int player)
+{
+	return (player == BLACK) ? WHITE : BLACK;
+}
+
+int square(int row, int col)
+{
+	return (row + 1) * width + col + 1;
+}
+
+/* Returns the bracketing square if playing move flips pieces in direction dir, 0 otherwise */
+int would_flip(int move, int dir, int player)
+{
+	int c = move + dir;
+
+	if (board[c] != opponent(player))
+		return 0;
+	while (board[c] == opponent(player))
+		c += dir;
+	return (board[c] == player) ? c : 0;
+}
+
+int legalp(int move, int player)
+{
+	int i;
+
+	if (board[move] != EMPTY)
+		return 0;
+	for (i = 0; i < 8; i++)
+	{
+		if (would_flip(move, directions[i], player))
+			return 1;
+	}
+	return 0;
+}
+
+int any_legal(int player)
+{
+	int row, col;
+
+	for (row = 0; row < size; row++)
+		for (col = 0; col < size; col++)
+			if (legalp(square(row, col), player))
+				return 1;
+	return 0;
+}
+
+void make_move(int move, int player)
+{
+	int i, c, bracketer;
+
+	for (i = 0; i < 8; i++)
+	{
+		bracketer = would_flip(move, directions[i], player);
+		if (bracketer)
+		{
+			for (c = move + directions[i]; c != bracketer; c += directions[i])
+				board[c] = player;
+		}
+	}
+	board[move] = player;
+}
+
+int count(int player)
+{
+	int i, cnt = 0;
+
+	for (i = 0; i < width * width; i++)
+		if (board[i] == player)
+			cnt++;
+	return cnt;
+}
+
+/* Converts "<row><col>" to a square, or FAILURE if it is not on the board */
+int parse_move(const char *move)
+{
+	int row = move[0] - '0';
+	int col = move[1] - '0';
+
+	if (row < 0 || row >= size || col < 0 || col >= size)
+		return FAILURE;
+	return square(row, col);
+}
+
+/////////////////////////////////////////////////////////////////// players
+
+/**
+ * Listens on 127.0.0.1, on any free port if *port is 0, and stores the port in *port
+ */
+int open_listener(int *port)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	/* not inherited by the players, a daemon has to see the port close */
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	int one = 1;
+
+	if (fd == -1)
+		return FAILURE;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	addr.sin_port = htons(*port);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0 ||
+		getsockname(fd, (struct sockaddr *)&addr, &len) < 0)
+	{
+		close(fd);
+		return FAILURE;
+	}
+	*port = ntohs(addr.sin_port);
+	return fd;
+}
+
+/**
+ * Starts the player in a process group of its own, so that mpirun and all
+ * of its ranks can be killed together
+ */
+pid_t spawn_player(struct player *p, const struct options *opts)
+{
+	char *args[MAXARGS];
+	char *launcher = strdup(opts->mpirun);
+	char port[16], time_limit[16], procs[16];
+	char *tok;
+	int nargs = 0;
+	int devnull;
+	pid_t pid;
+
+	if (opts->procs > 1)
+	{
+		for (tok = strtok(launcher, " "); tok != NULL && nargs < MAXARGS - 9; tok = strtok(NULL, " "))
+			args[nargs++] = tok;
+		snprintf(procs, sizeof(procs), "%d", opts->procs);
+		args[nargs++] = "-np";
+		args[nargs++] = procs;
+	}
+	snprintf(port, sizeof(port), "%d", p->port);
+	snprintf(time_limit, sizeof(time_limit), "%d", opts->time_limit);
+	args[nargs++] = (char *)p->path;
+	if (p->daemon)
+		args[nargs++] = "--daemon";
+	args[nargs++] = "127.0.0.1";
+	args[nargs++] = port;
+	args[nargs++] = time_limit;
+	args[nargs++] = p->logfile;
+	args[nargs] = NULL;
+
+	pid = fork();
+	if (pid == 0)
+	{
+		setpgid(0, 0);
+		if (!opts->verbose && (devnull = open("/dev/null", O_WRONLY)) != -1)
+		{
+			dup2(devnull, STDOUT_FILENO);
+			dup2(devnull, STDERR_FILENO);
+			close(devnull);
+		}
+		execvp(args[0], args);
+		perror(args[0]);
+		_exit(127);
+	}
+	if (pid > 0)
+		setpgid(pid, pid);
+	free(launcher);
+	return pid;
+}
+
+/* Whether the player was started and has not exited yet */
+int running(struct player *p)
+{
+	return p->pid > 0 && waitpid(p->pid, NULL, WNOHANG) == 0;
+}
+
+int accept_player(struct player *p, double timeout)
+{
+	struct pollfd pfd;
+
+	pfd.fd = p->listen_fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, (int)(timeout * 1000)) <= 0)
+		return FAILURE;
+	p->fd = accept4(p->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+	return (p->fd == -1) ? FAILURE : SUCCESS;
+}
+
+/* Sends cmd prefixed by its length as two digits, as comms_get_cmd expects */
+int send_cmd(int fd, const char *cmd)
+{
+	char buf[CMDBUFSIZE + 3];
+	int len = snprintf(buf, sizeof(buf), "%02d%s", (int)strlen(cmd), cmd);
+
+	return (send(fd, buf, len, 0) == len) ? SUCCESS : FAILURE;
+}
+
+/**
+ * Reads a move terminated by '\n' within timeout seconds
+ */
+int recv_move(int fd, char *move, double timeout)
+{
+	struct pollfd pfd;
+	double deadline = now() + timeout;
+	double left;
+	int len = 0;
+	ssize_t n;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while (len < MOVEBUFSIZE - 1)
+	{
+		left = deadline - now();
+		if (left <= 0 || poll(&pfd, 1, (int)(left * 1000) + 1) <= 0)
+			return FAILURE;
+		n = recv(fd, move + len, MOVEBUFSIZE - 1 - len, 0);
+		if (n <= 0)
+			return FAILURE;
+		len += n;
+		move[len] = '\0';
+		if (strchr(move, '\n') != NULL)
+			return SUCCESS;
+	}
+	return FAILURE;
+}
+
+/**
+ * Waits for the player to exit, and kills its process group when it takes too long
+ */
+void stop_player(struct player *p, double timeout)
+{
+	double deadline = now() + timeout;
+	struct timespec tick = {0, 10000000};
+
+	if (p->fd > 0)
+		close(p->fd);
+	p->fd = -1;
+	if (p->pid <= 0)
+		return;
+	while (waitpid(p->pid, NULL, WNOHANG) == 0)
+	{
+		if (now() > deadline)
+		{
+			kill(-p->pid, SIGKILL);
+			waitpid(p->pid, NULL, 0);
+			break;
+		}
+		nanosleep(&tick, NULL);
+	}
+	p->pid = 0;
+}
+
+/////////////////////////////////////////////////////////////////// game
+
+void play_game(struct player *players[3], const struct options *opts, struct game_result *result)
+{
+	static int game_nr = 0;
+	char move[MOVEBUFSIZE];
+	char cmd[CMDBUFSIZE];
+	const char *colours[3] = {"", "black", "white"};
+	int turn = BLACK;
+	int colour, loc;
+	double start;
+
+	size = opts->size;
+	initialise_board();
+	memset(result, 0, sizeof(*result));
+	result->reason = "normal";
+	result->winner = EMPTY;
+
+	/* both players start at the same time, each connects to its own port,
+	   a daemon that is still running from the last game only connects again */
+	for (colour = BLACK; colour <= WHITE; colour++)
+	{
+		players[colour]->fd = -1;
+		players[colour]->time_used = 0.0;
+		if (players[colour]->daemon && running(players[colour]))
+			continue;
+		snprintf(players[colour]->logfile, sizeof(players[colour]->logfile), "%s/%s_%d_%d.txt", opts->logdir,
+				 players[colour]->daemon ? players[colour]->name : colours[colour], (int)getpid(), game_nr);
+		players[colour]->pid = spawn_player(players[colour], opts);
+	}
+	game_nr++;
+	for (colour = BLACK; colour <= WHITE; colour++)
+	{
+		snprintf(cmd, sizeof(cmd), "%d", colour);
+		if (players[colour]->pid <= 0 || accept_player(players[colour], CONNECT_TIMEOUT) == FAILURE ||
+			send(players[colour]->fd, cmd, 1, 0) != 1)
+		{
+			result->winner = opponent(colour);
+			result->reason = "no connection";
+			break;
+		}
+	}
+
+	while (result->winner == EMPTY)
+	{
+		if (!any_legal(turn))
+		{
+			if (!any_legal(opponent(turn)))
+				break;
+			strcpy(result->moves[result->nr_moves++], "pass");
+			turn = opponent(turn);
+			continue;
+		}
+
+		start = now();
+		if (send_cmd(players[turn]->fd, "gen_move") == FAILURE ||
+			recv_move(players[turn]->fd, move, opts->time_limit + opts->grace) == FAILURE)
+		{
+			players[turn]->time_used += now() - start;
+			result->winner = opponent(turn);
+			result->reason = (now() - start >= opts->time_limit + opts->grace) ? "timeout" : "disconnect";
+			break;
+		}
+		players[turn]->time_used += now() - start;
+
+		loc = (strncmp(move, "pass", 4) == 0) ? FAILURE : parse_move(move);
+		if (loc == FAILURE || !legalp(loc, turn))
+		{
+			result->winner = opponent(turn);
+			result->reason = "illegal move";
+			break;
+		}
+		make_move(loc, turn);
+		snprintf(result->moves[result->nr_moves++], MOVEBUFSIZE, "%.2s", move);
+
+		snprintf(cmd, sizeof(cmd), "play_move %.2s", move);
+		send_cmd(players[opponent(turn)]->fd, cmd);
+		turn = opponent(turn);
+	}
+
+	result->discs[BLACK] = count(BLACK);
+	result->discs[WHITE] = count(WHITE);
+	if (strcmp(result->reason, "normal") == 0 && result->discs[BLACK] != result->discs[WHITE])
+		result->winner = (result->discs[BLACK] > result->discs[WHITE]) ? BLACK : WHITE;
+
+	for (colour = BLACK; colour <= WHITE; colour++)
+	{
+		if (players[colour]->fd > 0)
+			send_cmd(players[colour]->fd, "game_over");
+	}
+	for (colour = BLACK; colour <= WHITE; colour++)
+	{
+		if (!players[colour]->daemon)
+		{
+			stop_player(players[colour], EXIT_TIMEOUT);
+		}
+		else if (players[colour]->fd > 0)
+		{
+			close(players[colour]->fd);
+			players[colour]->fd = -1;
+		}
+	}
+}
+
+/**
+ * Writes one JSON line per game
+ */
+void write_result(FILE *fp, struct player *players[3], int game, const struct game_result *result)
+{
+	const char *winners[3] = {"draw", "black", "white"};
+	int i;
+
+	fprintf(fp, "{\"game\":%d,\"black\":\"%s\",\"white\":\"%s\",\"winner\":\"%s\",\"reason\":\"%s\","
+				"\"black_discs\":%d,\"white_discs\":%d,\"black_time\":%.3f,\"white_time\":%.3f,\"moves\":[",
+			game, players[BLACK]->path, players[WHITE]->path, winners[result->winner], result->reason,
+			result->discs[BLACK], result->discs[WHITE], players[BLACK]->time_used, players[WHITE]->time_used);
+	for (i = 0; i < result->nr_moves; i++)
+		fprintf(fp, "%s\"%s\"", (i == 0) ? "" : ",", result->moves[i]);
+	fprintf(fp, "]}\n");
+	fflush(fp);
+}